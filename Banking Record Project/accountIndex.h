@@ -0,0 +1,257 @@
+//disk resident hash index from account number to record position in record.bank.
+//the index file is made of 4 KiB pages: page 0 is the header, pages 1..buckets
+//are the hash buckets and overflow pages are added at the end when a bucket
+//fills up. the table doubles its buckets before the chains get long, so a
+//lookup normally reads a single page
+
+#ifndef BANK_ACCOUNTINDEX_H
+#define BANK_ACCOUNTINDEX_H
+
+#include "fileIO.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const int INDEX_PAGE_SIZE = 4096;
+const int INDEX_KEY_SIZE = 20; //same as account_number in the record
+
+struct index_entry
+{
+	char account_number[INDEX_KEY_SIZE];
+	int32_t record; //0 based record position in record.bank
+};
+
+const int INDEX_PAGE_ENTRIES = (INDEX_PAGE_SIZE - 2 * sizeof(int32_t)) / sizeof(index_entry);
+
+struct index_page
+{
+	int32_t count;    //entries used on this page
+	int32_t overflow; //next page of the bucket chain, 0 for none
+	index_entry entries[INDEX_PAGE_ENTRIES];
+	char pad[INDEX_PAGE_SIZE - 2 * sizeof(int32_t) - INDEX_PAGE_ENTRIES * sizeof(index_entry)];
+};
+
+struct index_header
+{
+	char magic[8];
+	int64_t buckets;
+	int64_t entries;
+	int64_t pages;   //pages in the file, header included
+	int64_t records; //record.bank slots this index was last brought up to date with
+	char pad[INDEX_PAGE_SIZE - 8 - 4 * sizeof(int64_t)];
+};
+
+class account_index
+{
+private:
+	//grow when the buckets are this full on average
+	const double MAX_FILL = 0.75;
+	const int64_t MIN_BUCKETS = 64;
+
+	block_file file;
+	index_header header;
+
+	static uint64_t hash_key(const char* key) {
+		uint64_t h = 14695981039346656037ULL; //FNV-1a
+		for (int i = 0; i < INDEX_KEY_SIZE && key[i] != '\0'; i++)
+		{
+			h ^= (unsigned char)key[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+	static bool same_key(const char* a, const char* b) {
+		return strncmp(a, b, INDEX_KEY_SIZE) == 0;
+	}
+
+	int64_t bucket_page(const char* key) const {
+		return 1 + (int64_t)(hash_key(key) % (uint64_t)header.buckets);
+	}
+
+	void read_page(int64_t page_no, index_page& page) {
+		if (file.read_at(&page, sizeof(page), page_no * INDEX_PAGE_SIZE) != sizeof(page))
+			memset(&page, 0, sizeof(page));
+	}
+
+	void write_page(int64_t page_no, const index_page& page) {
+		file.write_at(&page, sizeof(page), page_no * INDEX_PAGE_SIZE);
+	}
+
+	void write_header() {
+		file.write_at(&header, sizeof(header), 0);
+	}
+
+	//walk the chain of the key's bucket. on a match the page holding it is left
+	//in 'page' at 'page_no' and the slot is returned, otherwise -1 with the last
+	//page of the chain in 'page'
+	int locate(const char* key, index_page& page, int64_t& page_no) {
+		page_no = bucket_page(key);
+		while (true)
+		{
+			read_page(page_no, page);
+			for (int i = 0; i < page.count; i++)
+			{
+				if (same_key(page.entries[i].account_number, key))
+					return i;
+			}
+			if (page.overflow == 0) return -1;
+			page_no = page.overflow;
+		}
+	}
+
+	//write a fresh table with 'buckets' buckets holding 'all'. the entries are
+	//sorted by bucket first so every page is written once, in order
+	void bulk_load(std::vector<index_entry>& all, int64_t buckets, int64_t records) {
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, "ACCTIDX", 8);
+		header.buckets = buckets;
+		header.entries = (int64_t)all.size();
+		header.records = records;
+
+		std::vector<int64_t> bucket_of(all.size());
+		std::vector<size_t> order(all.size());
+		for (size_t i = 0; i < all.size(); i++)
+		{
+			bucket_of[i] = bucket_page(all[i].account_number);
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bucket_of[a] < bucket_of[b]; });
+
+		file.truncate(0);
+		int64_t next_overflow = 1 + buckets;
+		size_t k = 0;
+		index_page page;
+		for (int64_t b = 1; b <= buckets; b++)
+		{
+			int64_t page_no = b;
+			memset(&page, 0, sizeof(page));
+			while (k < order.size() && bucket_of[order[k]] == b)
+			{
+				if (page.count == INDEX_PAGE_ENTRIES)
+				{
+					page.overflow = (int32_t)next_overflow;
+					write_page(page_no, page);
+					page_no = next_overflow++;
+					memset(&page, 0, sizeof(page));
+				}
+				page.entries[page.count++] = all[order[k++]];
+			}
+			write_page(page_no, page);
+		}
+		header.pages = next_overflow;
+		write_header();
+	}
+
+	//read every entry of the table
+	std::vector<index_entry> all_entries() {
+		std::vector<index_entry> all;
+		all.reserve((size_t)header.entries);
+		index_page page;
+		for (int64_t p = 1; p < header.pages; p++)
+		{
+			read_page(p, page);
+			all.insert(all.end(), page.entries, page.entries + page.count);
+		}
+		return all;
+	}
+
+	void grow() {
+		std::vector<index_entry> all = all_entries();
+		bulk_load(all, header.buckets * 2, header.records);
+	}
+
+public:
+	//open or create the index file
+	bool open(const char* path) {
+		if (!file.open(path)) return false;
+		if (file.read_at(&header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, "ACCTIDX", 8) != 0)
+		{
+			std::vector<index_entry> none;
+			bulk_load(none, MIN_BUCKETS, 0);
+		}
+		return true;
+	}
+
+	//find the record position stored for an account number
+	bool find(const char* account_number, long& record) {
+		index_page page;
+		int64_t page_no;
+		int slot = locate(account_number, page, page_no);
+		if (slot < 0) return false;
+		record = page.entries[slot].record;
+		return true;
+	}
+
+	//map an account number to a record position, replacing any older mapping
+	void insert(const char* account_number, long record) {
+		index_page page;
+		int64_t page_no;
+		int slot = locate(account_number, page, page_no);
+		if (slot >= 0)
+		{
+			page.entries[slot].record = (int32_t)record;
+			write_page(page_no, page);
+			return;
+		}
+
+		//the chain is full, link a new overflow page at the end of the file
+		if (page.count == INDEX_PAGE_ENTRIES)
+		{
+			page.overflow = (int32_t)header.pages;
+			write_page(page_no, page);
+			page_no = header.pages++;
+			memset(&page, 0, sizeof(page));
+		}
+		index_entry& entry = page.entries[page.count++];
+		memset(&entry, 0, sizeof(entry));
+		strncpy(entry.account_number, account_number, INDEX_KEY_SIZE);
+		entry.record = (int32_t)record;
+		write_page(page_no, page);
+
+		header.entries++;
+		if (header.entries > header.buckets * INDEX_PAGE_ENTRIES * MAX_FILL) grow();
+		else write_header();
+	}
+
+	//drop an account number from the index
+	bool erase(const char* account_number) {
+		index_page page;
+		int64_t page_no;
+		int slot = locate(account_number, page, page_no);
+		if (slot < 0) return false;
+
+		page.entries[slot] = page.entries[--page.count];
+		write_page(page_no, page);
+		header.entries--;
+		write_header();
+		return true;
+	}
+
+	//replace the whole index, used after record positions changed
+	void rebuild(std::vector<index_entry>& all, long records) {
+		int64_t buckets = MIN_BUCKETS;
+		while ((double)all.size() > buckets * INDEX_PAGE_ENTRIES * MAX_FILL) buckets *= 2;
+		bulk_load(all, buckets, records);
+	}
+
+	//number of record.bank slots the index covers
+	long records() const {
+		return (long)header.records;
+	}
+
+	void set_records(long records) {
+		header.records = records;
+		write_header();
+	}
+
+	long size() const {
+		return (long)header.entries;
+	}
+};
+
+#endif //BANK_ACCOUNTINDEX_H
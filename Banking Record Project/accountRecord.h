@@ -0,0 +1,22 @@
+//layout of one record in record.bank, shared by the store and everything
+//that reads the file directly
+
+#ifndef BANK_ACCOUNTRECORD_H
+#define BANK_ACCOUNTRECORD_H
+
+struct account_record
+{
+	char account_number[20];
+	char firstName[10];
+	char lastName[10];
+	float total_Balance;
+};
+
+const int RECORD_SIZE = sizeof(account_record);
+
+//a slot with an empty account number holds no account
+inline bool is_free(const account_record& rec) {
+	return rec.account_number[0] == '\0';
+}
+
+#endif //BANK_ACCOUNTRECORD_H
@@ -0,0 +1,360 @@
+//batched positional reads and writes that are all in flight at once instead
+//of one after the other. on Linux they go through io_uring, set up with the
+//raw system calls so no liburing is needed; where io_uring is missing or not
+//allowed a small pool of threads runs them with pread/pwrite instead.
+//
+//submit() queues requests, reap() hands back completions in the order the
+//device finishes them, which is generally not the order they were queued in.
+//an async_io is driven by one thread at a time.
+//
+//Windows has neither, and the CRT handles have no positional I/O to give the
+//threads, so there open() leaves it closed and callers do their I/O in line
+
+#ifndef BANK_ASYNCIO_H
+#define BANK_ASYNCIO_H
+
+#include "fileIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define BANK_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+struct io_request
+{
+	bool write;
+	int fd;
+	void* buf;
+	uint32_t length;
+	long long offset;
+	uint64_t tag; //handed back with the completion
+};
+
+struct io_completion
+{
+	uint64_t tag;
+	long long result; //bytes moved, or -errno
+};
+
+class async_io
+{
+private:
+	unsigned depth = 0;
+	std::atomic<long> in_flight{ 0 };
+
+	//thread pool used when there is no io_uring
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable queued, finished;
+	std::deque<io_request> waiting;
+	std::deque<io_completion> done;
+	bool stopping = false;
+
+	static long long run_one(const io_request& r) {
+#ifdef _WIN32
+		(void)r;
+		return -ENOSYS;
+#else
+		ssize_t n = r.write ? pwrite(r.fd, r.buf, r.length, r.offset) : pread(r.fd, r.buf, r.length, r.offset);
+		return n < 0 ? -errno : n;
+#endif
+	}
+
+	void work() {
+		std::unique_lock<std::mutex> held(lock);
+		while (true)
+		{
+			while (waiting.empty() && !stopping) queued.wait(held);
+			if (waiting.empty()) return;
+			io_request r = waiting.front();
+			waiting.pop_front();
+			held.unlock();
+			io_completion c = { r.tag, run_one(r) };
+			held.lock();
+			done.push_back(c);
+			finished.notify_all();
+		}
+	}
+
+#ifdef BANK_HAVE_IO_URING
+	int ring = -1;
+	void* sq_map = nullptr;
+	void* cq_map = nullptr;
+	size_t sq_map_size = 0, cq_map_size = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqes_size = 0;
+	unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+	unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+	io_uring_cqe* cqes = nullptr;
+	unsigned to_submit = 0;
+	std::vector<iovec> vectors; //one per submission slot
+
+	bool setup_ring(unsigned entries) {
+		io_uring_params p;
+		memset(&p, 0, sizeof(p));
+		ring = (int)syscall(__NR_io_uring_setup, entries, &p);
+		if (ring < 0) return false;
+		//the iovec of a slot is reused once its entry was submitted, which is
+		//only safe on kernels that copy it at submission
+		if (!(p.features & IORING_FEAT_SUBMIT_STABLE)) return close_ring();
+
+		sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single) sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+		sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+		if (sq_map == MAP_FAILED) return close_ring();
+		cq_map = single ? sq_map : mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+		if (cq_map == MAP_FAILED) return close_ring();
+		sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+		sqes = (io_uring_sqe*)mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED) return close_ring();
+
+		char* sq = (char*)sq_map;
+		char* cq = (char*)cq_map;
+		sq_head = (unsigned*)(sq + p.sq_off.head);
+		sq_tail = (unsigned*)(sq + p.sq_off.tail);
+		sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+		sq_array = (unsigned*)(sq + p.sq_off.array);
+		cq_head = (unsigned*)(cq + p.cq_off.head);
+		cq_tail = (unsigned*)(cq + p.cq_off.tail);
+		cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+		cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+		depth = p.sq_entries;
+		vectors.resize(depth);
+		return true;
+	}
+
+	bool close_ring() {
+		if (sqes != nullptr && sqes != MAP_FAILED) munmap(sqes, sqes_size);
+		if (cq_map != nullptr && cq_map != MAP_FAILED && cq_map != sq_map) munmap(cq_map, cq_map_size);
+		if (sq_map != nullptr && sq_map != MAP_FAILED) munmap(sq_map, sq_map_size);
+		if (ring >= 0) ::close(ring);
+		ring = -1;
+		sq_map = cq_map = nullptr;
+		sqes = nullptr;
+		return false;
+	}
+
+	//tell the kernel about the queued entries and wait for 'wait_for'
+	//completions. returns 0, also when the kernel is busy and completions
+	//have to be reaped first, or the -errno of a failure
+	int enter(unsigned wait_for) {
+		while (true)
+		{
+			int r = (int)syscall(__NR_io_uring_enter, ring, to_submit, wait_for,
+				wait_for > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (r >= 0)
+			{
+				to_submit -= (unsigned)r < to_submit ? (unsigned)r : to_submit;
+				if (to_submit == 0 || wait_for > 0) return 0;
+			}
+			else if (errno == EAGAIN || errno == EBUSY) return 0;
+			else if (errno != EINTR) return -errno;
+		}
+	}
+
+	//take the entries the kernel has not been told about back off the
+	//ring and hand them back as failed with 'error'
+	template <class F>
+	long fail_unsubmitted(int error, F on_done) {
+		std::vector<io_completion> failed;
+		unsigned tail = *sq_tail;
+		for (; to_submit > 0; to_submit--)
+		{
+			tail--;
+			io_completion c = { sqes[tail & *sq_mask].user_data, (long long)error };
+			failed.push_back(c);
+		}
+		__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+		for (const io_completion& c : failed)
+		{
+			in_flight--;
+			on_done(c);
+		}
+		return (long)failed.size();
+	}
+#endif
+
+public:
+	~async_io() { close(); }
+
+	//start io_uring with room for 'queue_depth' requests in flight, or the
+	//thread pool with 'threads' threads if that fails
+	void open(unsigned queue_depth = 256, int threads = 4) {
+		close();
+#ifdef BANK_HAVE_IO_URING
+		if (setup_ring(queue_depth)) return;
+#endif
+#ifdef _WIN32
+		return;
+#endif
+		depth = queue_depth;
+		stopping = false;
+		for (int i = 0; i < threads; i++) workers.emplace_back(&async_io::work, this);
+	}
+
+	void close() {
+#ifdef BANK_HAVE_IO_URING
+		if (ring >= 0)
+		{
+			close_ring();
+			return;
+		}
+#endif
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		queued.notify_all();
+		for (auto& w : workers) w.join();
+		workers.clear();
+		waiting.clear();
+		done.clear();
+		in_flight = 0;
+	}
+
+	bool is_open() const {
+#ifdef BANK_HAVE_IO_URING
+		if (ring >= 0) return true;
+#endif
+		return !workers.empty();
+	}
+
+	bool uses_io_uring() const {
+#ifdef BANK_HAVE_IO_URING
+		return ring >= 0;
+#else
+		return false;
+#endif
+	}
+
+	//requests that can be in flight at once
+	unsigned queue_depth() const { return depth; }
+
+	long pending() const { return in_flight.load(); }
+
+	//queue one request, false when queue_depth() requests are already in
+	//flight and some have to be reaped first
+	bool submit(const io_request& r) {
+		if (in_flight.load() >= (long)depth) return false;
+		//counted for the thread that asks, whichever thread does the I/O
+		(r.write ? thread_io().written : thread_io().read) += r.length;
+#ifdef BANK_HAVE_IO_URING
+		if (ring >= 0)
+		{
+			unsigned tail = *sq_tail;
+			unsigned index = tail & *sq_mask;
+			io_uring_sqe* sqe = &sqes[index];
+			memset(sqe, 0, sizeof(*sqe));
+			vectors[index].iov_base = r.buf;
+			vectors[index].iov_len = r.length;
+			sqe->opcode = r.write ? IORING_OP_WRITEV : IORING_OP_READV;
+			sqe->fd = r.fd;
+			sqe->addr = (uint64_t)(uintptr_t)&vectors[index];
+			sqe->len = 1;
+			sqe->off = (uint64_t)r.offset;
+			sqe->user_data = r.tag;
+			sq_array[index] = index;
+			__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+			to_submit++;
+			in_flight++;
+			return true;
+		}
+#endif
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			waiting.push_back(r);
+		}
+		in_flight++;
+		queued.notify_one();
+		return true;
+	}
+
+	//wait until at least 'min' completions are in, then call done(completion)
+	//for every completion available. returns how many were handed back.
+	//requests io_uring would not take come back with their -errno; throws
+	//if it can not be waited on
+	template <class F>
+	long reap(long min, F on_done) {
+		if (min > in_flight.load()) min = in_flight.load();
+		long count = 0;
+#ifdef BANK_HAVE_IO_URING
+		if (ring >= 0)
+		{
+			while (true)
+			{
+				unsigned head = *cq_head;
+				unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+				while (head != tail)
+				{
+					io_uring_cqe* cqe = &cqes[head & *cq_mask];
+					io_completion c = { cqe->user_data, (long long)cqe->res };
+					head++;
+					__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+					in_flight--;
+					count++;
+					on_done(c);
+				}
+				if (count >= min && to_submit == 0) return count;
+				int error = enter(count >= min ? 0 : 1);
+				if (error == 0) continue;
+				//requests that never reached the kernel come back failed, for
+				//the caller to do them another way. a wait that fails would
+				//leave the ones in flight without an end
+				if (to_submit > 0) count += fail_unsubmitted(error, on_done);
+				else throw std::runtime_error(std::string("io_uring_enter failed: ") + strerror(-error));
+			}
+		}
+#endif
+		std::deque<io_completion> ready;
+		{
+			std::unique_lock<std::mutex> held(lock);
+			while ((long)done.size() < min) finished.wait(held);
+			ready.swap(done);
+		}
+		for (const io_completion& c : ready)
+		{
+			in_flight--;
+			count++;
+			on_done(c);
+		}
+		return count;
+	}
+
+	//run a whole batch, keeping up to queue_depth() requests in flight, and
+	//call done(completion) for each as it finishes
+	template <class F>
+	void run(const io_request* requests, size_t n, F on_done) {
+		size_t next = 0;
+		while (next < n || in_flight.load() > 0)
+		{
+			while (next < n && submit(requests[next])) next++;
+			reap(1, on_done);
+		}
+	}
+};
+
+#endif //BANK_ASYNCIO_H
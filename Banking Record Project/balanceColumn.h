@@ -0,0 +1,282 @@
+//columnar side store of the account balances. record.bal holds one 64 bit
+//fixed point amount in cents per record.bank slot, and the same array is kept
+//in memory, so aggregate reports scan 8 contiguous bytes per account instead of
+//44 byte rows, and add up exact integers instead of floats. deleted slots hold
+//FREE_BALANCE, which every kernel skips.
+//
+//changes are made to the array only and reach record.bal at sync(), which
+//the store calls at a checkpoint once the log holds them, so the file is
+//never ahead of the log. after a crash the log replays what the file lacks.
+//
+//the kernels use AVX2 when the compiler targets it (-mavx2, /arch:AVX2) and
+//plain loops otherwise
+
+#ifndef BANK_BALANCECOLUMN_H
+#define BANK_BALANCECOLUMN_H
+
+#include "accountRecord.h"
+#include "fileIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+const int64_t FREE_BALANCE = INT64_MIN;
+
+//balance of a row in cents, for rows that only carry the float
+inline int64_t to_cents(float balance) {
+	return (int64_t)llround((double)balance * 100.0);
+}
+
+//parse a decimal amount such as "-12", "12.5" or "12.50" into cents without
+//going through floating point. false for anything else
+inline bool parse_cents(const char* text, int64_t& cents) {
+	const char* p = text;
+	bool negative = *p == '-';
+	if (*p == '-' || *p == '+') p++;
+	if (*p < '0' || *p > '9') return false;
+
+	int64_t whole = 0;
+	while (*p >= '0' && *p <= '9')
+	{
+		if (whole > (INT64_MAX / 100 - 9) / 10) return false;
+		whole = whole * 10 + (*p++ - '0');
+	}
+	int64_t fraction = 0;
+	if (*p == '.')
+	{
+		p++;
+		int digits = 0;
+		while (*p >= '0' && *p <= '9')
+		{
+			if (++digits > 2) return false;
+			fraction = fraction * 10 + (*p++ - '0');
+		}
+		if (digits == 1) fraction *= 10;
+	}
+	if (*p != '\0') return false;
+	cents = whole * 100 + fraction;
+	if (negative) cents = -cents;
+	return true;
+}
+
+//cents as a decimal amount, "-12.05" for -1205
+inline std::string format_cents(int64_t cents) {
+	uint64_t magnitude = cents < 0 ? 0 - (uint64_t)cents : (uint64_t)cents;
+	std::string text = std::to_string(magnitude / 100);
+	text += '.';
+	text += (char)('0' + magnitude % 100 / 10);
+	text += (char)('0' + magnitude % 10);
+	return cents < 0 ? "-" + text : text;
+}
+
+struct balance_summary
+{
+	long accounts = 0;
+	int64_t total = 0;
+	int64_t min = 0;
+	int64_t max = 0;
+};
+
+class balance_column
+{
+private:
+	block_file file;
+	std::vector<int64_t> cents; //one entry per record.bank slot
+	//first and last slot changed since the last sync, set from many threads
+	std::atomic<long> dirty_first{ LONG_MAX };
+	std::atomic<long> dirty_last{ -1 };
+
+	void changed(long first, long last) {
+		long seen = dirty_first.load();
+		while (first < seen && !dirty_first.compare_exchange_weak(seen, first)) {}
+		seen = dirty_last.load();
+		while (last > seen && !dirty_last.compare_exchange_weak(seen, last)) {}
+	}
+
+public:
+	//open record.bal and load it, false if the file can not be opened
+	bool open(const char* path) {
+		if (!file.open(path)) return false;
+		cents.resize((size_t)(file.size() / sizeof(int64_t)));
+		if (!cents.empty()) file.read_at(cents.data(), cents.size() * sizeof(int64_t), 0);
+		return true;
+	}
+
+	long size() const { return (long)cents.size(); }
+
+	const int64_t* data() const { return cents.data(); }
+
+	int64_t get(long slot) const { return cents[slot]; }
+
+	//store the balance of a slot, growing the column when the slot is new
+	void set(long slot, int64_t value) {
+		if (slot >= (long)cents.size()) cents.resize(slot + 1, FREE_BALANCE);
+		cents[slot] = value;
+		changed(slot, slot);
+	}
+
+	//append the balances of consecutive new slots
+	void append(const int64_t* values, long n) {
+		long first = (long)cents.size();
+		cents.insert(cents.end(), values, values + n);
+		changed(first, first + n - 1);
+	}
+
+	//replace the whole column
+	void reset(const std::vector<int64_t>& values) {
+		cents = values;
+		changed(0, (long)cents.size() - 1);
+	}
+
+	//write the slots changed since the last sync with one write, cut the file
+	//to the column and flush it. nothing may change the column meanwhile
+	void sync() {
+		long first = dirty_first.exchange(LONG_MAX);
+		long last = std::min(dirty_last.exchange(-1), (long)cents.size() - 1);
+		long long bytes = (long long)cents.size() * sizeof(int64_t);
+		if (file.size() > bytes) file.truncate(bytes);
+		if (first <= last)
+			file.write_at(cents.data() + first, (size_t)(last - first + 1) * sizeof(int64_t), (long long)first * sizeof(int64_t));
+		file.sync();
+	}
+
+	//count, sum, min and max over every live slot
+	balance_summary summarize() const {
+		balance_summary s;
+		const int64_t* v = cents.data();
+		long n = (long)cents.size();
+		long i = 0;
+		int64_t total = 0, count = 0, lo = INT64_MAX, hi = INT64_MIN;
+#if defined(__AVX2__)
+		const __m256i free_value = _mm256_set1_epi64x(FREE_BALANCE);
+		const __m256i ones = _mm256_set1_epi64x(1);
+		__m256i vsum = _mm256_setzero_si256();
+		__m256i vcount = _mm256_setzero_si256();
+		__m256i vmin = _mm256_set1_epi64x(INT64_MAX);
+		__m256i vmax = _mm256_set1_epi64x(INT64_MIN);
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+			__m256i is_free = _mm256_cmpeq_epi64(x, free_value);
+			__m256i live = _mm256_andnot_si256(is_free, x); //free slots add 0
+			vsum = _mm256_add_epi64(vsum, live);
+			vcount = _mm256_add_epi64(vcount, _mm256_andnot_si256(is_free, ones));
+			//FREE_BALANCE is already the smallest value so it never wins max,
+			//for min it is swapped for the largest value first
+			__m256i for_min = _mm256_blendv_epi8(x, _mm256_set1_epi64x(INT64_MAX), is_free);
+			vmin = _mm256_blendv_epi8(vmin, for_min, _mm256_cmpgt_epi64(vmin, for_min));
+			vmax = _mm256_blendv_epi8(vmax, x, _mm256_cmpgt_epi64(x, vmax));
+		}
+		alignas(32) int64_t lanes[4][4];
+		_mm256_store_si256((__m256i*)lanes[0], vsum);
+		_mm256_store_si256((__m256i*)lanes[1], vcount);
+		_mm256_store_si256((__m256i*)lanes[2], vmin);
+		_mm256_store_si256((__m256i*)lanes[3], vmax);
+		for (int k = 0; k < 4; k++)
+		{
+			total += lanes[0][k];
+			count += lanes[1][k];
+			lo = std::min(lo, lanes[2][k]);
+			hi = std::max(hi, lanes[3][k]);
+		}
+#endif
+		for (; i < n; i++)
+		{
+			if (v[i] == FREE_BALANCE) continue;
+			total += v[i];
+			count++;
+			lo = std::min(lo, v[i]);
+			hi = std::max(hi, v[i]);
+		}
+		s.accounts = (long)count;
+		s.total = total;
+		s.min = count ? lo : 0;
+		s.max = count ? hi : 0;
+		return s;
+	}
+
+	//slots whose balance is between 'low' and 'high' cents, both included
+	std::vector<long> filter(int64_t low, int64_t high) const {
+		std::vector<long> slots;
+		const int64_t* v = cents.data();
+		long n = (long)cents.size();
+		long i = 0;
+		if (low == FREE_BALANCE) low++;
+#if defined(__AVX2__)
+		const __m256i below = _mm256_set1_epi64x(low);
+		const __m256i above = _mm256_set1_epi64x(high);
+		const __m256i free_value = _mm256_set1_epi64x(FREE_BALANCE);
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+			//a lane is out when it is below low, above high or a free slot
+			__m256i out = _mm256_or_si256(_mm256_cmpgt_epi64(below, x), _mm256_cmpgt_epi64(x, above));
+			out = _mm256_or_si256(out, _mm256_cmpeq_epi64(x, free_value));
+			int miss = _mm256_movemask_pd(_mm256_castsi256_pd(out));
+			if (miss == 0xF)
+				continue;
+			for (int k = 0; k < 4; k++)
+			{
+				if (!(miss & (1 << k))) slots.push_back(i + k);
+			}
+		}
+#endif
+		for (; i < n; i++)
+		{
+			if (v[i] >= low && v[i] <= high) slots.push_back(i);
+		}
+		return slots;
+	}
+
+	//the n largest balances as (cents, slot), largest first
+	std::vector<std::pair<int64_t, long>> top(long n) const {
+		typedef std::pair<int64_t, long> entry;
+		std::priority_queue<entry, std::vector<entry>, std::greater<entry>> best;
+		for (long i = 0; i < (long)cents.size() && n > 0; i++)
+		{
+			if (cents[i] == FREE_BALANCE) continue;
+			if ((long)best.size() < n) best.push(entry(cents[i], i));
+			else if (cents[i] > best.top().first)
+			{
+				best.pop();
+				best.push(entry(cents[i], i));
+			}
+		}
+		std::vector<entry> out;
+		while (!best.empty())
+		{
+			out.push_back(best.top());
+			best.pop();
+		}
+		std::reverse(out.begin(), out.end());
+		return out;
+	}
+
+	//count balances into 'buckets' equal ranges of 'width' cents starting at
+	//'low'. balances below or above the range go to the first or last bucket
+	std::vector<long> histogram(int64_t low, int64_t width, int buckets) const {
+		std::vector<long> counts(buckets, 0);
+		for (long i = 0; i < (long)cents.size(); i++)
+		{
+			if (cents[i] == FREE_BALANCE) continue;
+			int64_t b = cents[i] < low ? 0 : (cents[i] - low) / width;
+			counts[b >= buckets ? buckets - 1 : (int)b]++;
+		}
+		return counts;
+	}
+};
+
+#endif //BANK_BALANCECOLUMN_H
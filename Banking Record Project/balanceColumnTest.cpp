@@ -0,0 +1,127 @@
+//checks the balance_column kernels against plain loops over the same
+//values. build it once as it is and once with -mavx2 (/arch:AVX2): both
+//builds have to agree with the loops, so the vector kernels give the same
+//answers as the scalar ones, deleted slots and range edges included.
+//prints the first mismatch and exits with 1, or prints "ok"
+//
+//usage: balanceColumnTest [random columns]
+//	random columns	columns of random balances to check (default 200)
+
+#include "balanceColumn.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+static void check_filter(const balance_column& column, const std::vector<int64_t>& values, int64_t low, int64_t high) {
+	std::vector<long> expected;
+	for (long i = 0; i < (long)values.size(); i++)
+	{
+		if (values[i] != FREE_BALANCE && values[i] >= low && values[i] <= high) expected.push_back(i);
+	}
+	std::vector<long> got = column.filter(low, high);
+	if (got == expected) return;
+	if (failures++ == 0)
+	{
+		printf("filter(%lld, %lld) on %zu slots: %zu slot(s), expected %zu\n",
+			(long long)low, (long long)high, values.size(), got.size(), expected.size());
+	}
+}
+
+static void check_summary(const balance_column& column, const std::vector<int64_t>& values) {
+	balance_summary expected;
+	for (int64_t v : values)
+	{
+		if (v == FREE_BALANCE) continue;
+		expected.min = expected.accounts == 0 || v < expected.min ? v : expected.min;
+		expected.max = expected.accounts == 0 || v > expected.max ? v : expected.max;
+		expected.total += v;
+		expected.accounts++;
+	}
+	balance_summary got = column.summarize();
+	if (got.accounts == expected.accounts && got.total == expected.total && got.min == expected.min && got.max == expected.max)
+		return;
+	if (failures++ == 0)
+	{
+		printf("summarize() on %zu slots: %ld accounts, total %lld, min %lld, max %lld, expected %ld, %lld, %lld, %lld\n",
+			values.size(), got.accounts, (long long)got.total, (long long)got.min, (long long)got.max,
+			expected.accounts, (long long)expected.total, (long long)expected.min, (long long)expected.max);
+	}
+}
+
+static void check(const std::vector<int64_t>& values) {
+	balance_column column;
+	column.reset(values);
+	check_summary(column, values);
+	const int64_t edges[] = { FREE_BALANCE, FREE_BALANCE + 1, FREE_BALANCE + 2, -100000, -1, 0, 1, 100000, INT64_MAX - 1, INT64_MAX };
+	for (int64_t low : edges)
+	{
+		for (int64_t high : edges) check_filter(column, values, low, high);
+	}
+}
+
+int main(int argc, char** argv) {
+	int columns = argc > 1 ? atoi(argv[1]) : 200;
+#if defined(__AVX2__)
+	printf("AVX2 kernels\n");
+#else
+	printf("scalar kernels\n");
+#endif
+
+	//values at the edges, the largest kept small enough for their sum to fit.
+	//every column of up to 5 slots takes every mix of them, which covers one
+	//full vector and the tail loop with a free slot in every lane; columns
+	//of 6 to 16 slots, two vectors and a tail, take a random one per slot
+	const int64_t picks[] = { FREE_BALANCE, INT64_MIN / 16, -1, 0, 1, INT64_MAX / 16 };
+	const int kinds = (int)(sizeof(picks) / sizeof(picks[0]));
+	for (int n = 0; n <= 5; n++)
+	{
+		long combinations = 1;
+		for (int k = 0; k < n; k++) combinations *= kinds;
+		for (long c = 0; c < combinations; c++)
+		{
+			std::vector<int64_t> values(n);
+			long rest = c;
+			for (int k = 0; k < n; k++)
+			{
+				values[k] = picks[rest % kinds];
+				rest /= kinds;
+			}
+			check(values);
+		}
+	}
+
+	std::mt19937_64 random(42);
+	for (int n = 6; n <= 16; n++)
+	{
+		for (int c = 0; c < 2000; c++)
+		{
+			std::vector<int64_t> values(n);
+			for (int64_t& v : values) v = picks[random() % kinds];
+			check(values);
+		}
+	}
+
+	for (int c = 0; c < columns; c++)
+	{
+		std::vector<int64_t> values(random() % 1000);
+		for (int64_t& v : values)
+		{
+			int pick = (int)(random() % 4);
+			v = pick == 0 ? FREE_BALANCE : pick == 1 ? (int64_t)(random() % 200001) - 100000 : (int64_t)random() >> 12;
+		}
+		check(values);
+	}
+
+	if (failures > 0)
+	{
+		printf("%d mismatch(es)\n", failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
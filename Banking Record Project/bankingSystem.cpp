@@ -1,32 +1,70 @@
 #include<iostream>
 #include<fstream>
 #include<cstdlib>
+#include<cstring>
+#include<vector>
+#include<stdexcept>
+#include<chrono>
+#include<string>
+#include "accountIndex.h"
+#include "nameIndex.h"
+#include "recordStore.h"
+#include "bulkTransfer.h"
+#include "transactionEngine.h"
+#include "storeBenchmark.h"
 
 using std::cout;
 using std::cin;
+using std::cerr;
 using std::endl;
-using std::fstream;
-using std::ofstream;
-using std::ifstream;
-using std::ios;
+using std::vector;
+using std::string;
 
-class account_query
+//the account fields come from account_record, so the object can be handed to
+//the store as is. the exact balance in cents is kept beside them
+class account_query : private account_record
 {
 private:
-	char account_number[20];
-	char firstName[10];
-	char lastName[10];
-	float total_Balance;
+	int64_t balance_cents = 0;
+
+	//the record file, the account number -> slot index and the name index,
+	//shared by every account_query
+	static record_store store;
+	static account_index index;
+	static name_index names;
+	static transaction_engine engine;
+
+	long ask_record(const char* action);
+	bool ask_amount(int64_t& cents);
+	int load_test(int argc, char** argv);
+	int benchmark(int argc, char** argv);
 public:
 	void read_data();
 	void show_data();
 	void write_rec();
 	void read_rec();
 	void search_rec();
+	void search_acc();
+	void search_name();
 	void edit_rec();
 	void delete_rec();
+	void compact_rec();
+	void balance_report();
+	void deposit_rec();
+	void withdraw_rec();
+	void transfer_rec();
+	void open_store();
+	void commit_store();
+	void close_store();
+	void rebuild_index();
+	int run_batch(int argc, char** argv);
 };
 
+record_store account_query::store;
+account_index account_query::index;
+name_index account_query::names;
+transaction_engine account_query::engine(account_query::store, account_query::index);
+
 void account_query::read_data() {
 	cout << "\nEnter Account Number: ";
 	cin >> account_number;
@@ -35,7 +73,10 @@ void account_query::read_data() {
 	cout << "Enter Last Name: ";
 	cin >> lastName;
 	cout << "Enter Balance: ";
-	cin >> total_Balance;
+	string amount;
+	while (cin >> amount && !parse_cents(amount.c_str(), balance_cents))
+		cout << "Enter the Balance as an amount with at most 2 decimals: ";
+	total_Balance = (float)((double)balance_cents / 100.0);
 	cout << endl;
 }
 
@@ -43,118 +84,543 @@ void account_query::show_data() {
 	cout << "Account Number: " << account_number << endl;
 	cout << "First Name: " << firstName << endl;
 	cout << "Last Name: " << lastName << endl;
-	cout << "Current Balance: Rs. " << total_Balance << endl;
+	cout << "Current Balance: Rs. " << format_cents(balance_cents) << endl;
 	cout << "--------------------------------------" << endl;
 }
 
+//ask for a record number and load that record, returns its slot or -1
+long account_query::ask_record(const char* action) {
+	int n;
+	cout << "\n There are " << store.count() << " record in the file";
+	cout << "\n Enter Record Number to " << action << ": ";
+	cin >> n;
+	if (!store.read(n - 1, *this))
+	{
+		cout << "\nRecord " << n << " does not exist!" << endl;
+		return -1;
+	}
+	if (is_free(*this))
+	{
+		cout << "\nRecord " << n << " was deleted!" << endl;
+		return -1;
+	}
+	balance_cents = store.balance(n - 1);
+	return n - 1;
+}
+
 void account_query::write_rec() {
-	ofstream outfile;
-	outfile.open("record.bank", ios::binary | ios::app);
 	read_data();
-	outfile.write(reinterpret_cast<char*>(this), sizeof(*this));
-	outfile.close();
+	long found;
+	if (index.find(account_number, found))
+	{
+		cout << "Account Number already exists in record " << found + 1 << endl;
+		return;
+	}
+	long record = store.insert(*this, balance_cents);
+	index.insert(account_number, record);
+	index.set_records(store.count());
+	names.insert(lastName, firstName, record);
+	names.set_records(store.count());
 }
+
 void account_query::read_rec()
 {
-	ifstream infile;
-	infile.open("record.bank", ios::binary);
-	if (!infile)
+	if (store.live() == 0)
 	{
 		cout << "Error in Opening! File Not Found!!" << endl;
 		return;
 	}
+	//read from a snapshot, so the listing is of one moment however long it takes
+	record_snapshot snapshot(store);
 	cout << "\n****Data from file****" << endl;
-	while (!infile.eof())
-	{
-		if (infile.read(reinterpret_cast<char*>(this), sizeof(*this)))
-		{
-			show_data();
-		}
-	}
-	infile.close();
+	snapshot.scan([this](long, const account_record& rec, int64_t cents) {
+		static_cast<account_record&>(*this) = rec;
+		balance_cents = cents;
+		show_data();
+		});
 }
 
 void account_query::search_rec() {
-	int n;
-	ifstream infile;
-	infile.open("record.bank", ios::binary);
+	if (ask_record("Search") < 0) return;
+	show_data();
+}
 
-	if (!infile)
+//find a record by account number through the index instead of reading the file
+void account_query::search_acc() {
+	char number[20];
+	long record;
+	cout << "\n Enter Account Number to Search: ";
+	cin >> number;
+	if (!index.find(number, record) || !store.read(record, *this))
 	{
-		cout << "\nError in opening! File Not Found!" << endl;
+		cout << "\nAccount Number not found!" << endl;
 		return;
 	}
-
-	infile.seekg(0, ios::end);
-	int count = infile.tellg() / sizeof(*this);
-	cout << "\n There are " << count << " record in the file";
-	cout << "\n Enter Record Number to Search: ";
-	cin >> n;
-	infile.seekg((n - 1) * sizeof(*this));
-	infile.read(reinterpret_cast<char*>(this), sizeof(*this));
+	balance_cents = store.balance(record);
+	cout << "\nRecord " << record + 1 << endl;
 	show_data();
 }
 
-void account_query::edit_rec() {
-	int n;
-	fstream iofile;
-	iofile.open("record.bank", ios::in | ios::binary);
-	if (!iofile)
+//find records by last name, and first name when one is given, through the
+//name index. a name ending in * matches every name starting with the rest
+void account_query::search_name() {
+	string last, first;
+	cout << "\n Enter Last Name (Sm* for every name starting with Sm): ";
+	cin >> last;
+	cout << " Enter First Name (* for any): ";
+	cin >> first;
+	bool last_prefix = !last.empty() && last.back() == '*';
+	bool first_prefix = !first.empty() && first.back() == '*';
+	if (last_prefix) last.pop_back();
+	if (first_prefix) first.pop_back();
+
+	vector<long> found = names.find(last.c_str(), last_prefix, first.c_str(), first_prefix);
+	if (found.empty())
 	{
-		cout << "\nError in opening! File Not Found";
+		cout << "\nNo account with that name!" << endl;
 		return;
 	}
-	iofile.seekg(0, ios::end);
-	int count = iofile.tellg() / sizeof(*this);
-	cout << "\n There are " << count << " record in the file";
-	cout << "\n Enter Record Number to edit: ";
-	cin >> n;
-	iofile.seekg((n - 1) * sizeof(*this));
-	iofile.read(reinterpret_cast<char*>(this), sizeof(*this));
-	cout << "Record " << n << " has following data" << endl;
+	cout << "\n" << found.size() << " account(s) found" << endl;
+	//the records come in as they are read, they are shown in name order
+	vector<account_record> recs(found.size());
+	vector<char> ok(found.size(), 0);
+	store.read_batch(found.data(), found.size(), recs.data(), [&ok](size_t i, bool read) { ok[i] = read; });
+	for (size_t i = 0; i < found.size(); i++)
+	{
+		if (!ok[i] || is_free(recs[i])) continue;
+		static_cast<account_record&>(*this) = recs[i];
+		balance_cents = store.balance(found[i]);
+		cout << "\nRecord " << found[i] + 1 << endl;
+		show_data();
+	}
+}
+
+void account_query::edit_rec() {
+	long record = ask_record("edit");
+	if (record < 0) return;
+	cout << "Record " << record + 1 << " has following data" << endl;
 	show_data();
-	iofile.close();
-	iofile.open("record.bank", ios::out | ios::in | ios::binary);
-	iofile.seekp((n - 1) * sizeof(*this));
+	char old_number[20], old_first[10], old_last[10];
+	strcpy(old_number, account_number);
+	strcpy(old_first, firstName);
+	strcpy(old_last, lastName);
 	cout << "\nEnter data to Modify " << endl;
 	read_data();
-	iofile.write(reinterpret_cast<char*>(this), sizeof(*this));
+	long found;
+	if (index.find(account_number, found) && found != record)
+	{
+		cout << "Account Number already exists in record " << found + 1 << endl;
+		return;
+	}
+	store.write(record, *this, balance_cents);
+	if (strcmp(old_number, account_number) != 0)
+	{
+		index.erase(old_number);
+		index.insert(account_number, record);
+	}
+	names.erase(old_last, old_first, record);
+	names.insert(lastName, firstName, record);
 }
 
+//clear the record in place, its slot is reused by the next write_rec
 void account_query::delete_rec() {
-	int n;
-	ifstream infile;
-	infile.open("record.bank", ios::binary);
-	if (!infile)
+	long record = ask_record("Delete");
+	if (record < 0) return;
+	index.erase(account_number);
+	names.erase(lastName, firstName, record);
+	store.erase(record);
+
+	//give the space back once half of the file is deleted slots
+	if (store.needs_compaction())
+		compact_rec();
+}
+
+//rewrite record.bank without deleted slots
+void account_query::compact_rec() {
+	long reclaimed = store.compact();
+	if (reclaimed < 0)
 	{
-		cout << "\nError in opening! File Not Found!" << endl;
+		cout << "\nRecord file is being read by a report, try compacting later" << endl;
 		return;
 	}
-	infile.seekg(0, ios::end);
-	int count = infile.tellg() / sizeof(*this);
-	cout << "\n There are " << count << " record in the file";
-	cout << "\n Enter Record Number to Delete: ";
-	cin >> n;
-	fstream tmpfile;
-	tmpfile.open("tmpfile.bank", ios::out | ios::binary);
-	infile.seekg(0);
-	for (int i = 0; i < count; i++)
+	rebuild_index();
+	cout << "\nCompacted record file, " << reclaimed << " deleted record(s) removed" << endl;
+}
+
+//total deposits, balance range, the largest accounts and how the balances are
+//spread, all computed from the cents column without touching record.bank
+//except to name the top accounts
+void account_query::balance_report() {
+	const balance_column& balances = store.balances();
+	auto began = std::chrono::steady_clock::now();
+	balance_summary summary = balances.summarize();
+	long overdrawn = (long)balances.filter(FREE_BALANCE + 1, -1).size();
+	vector<std::pair<int64_t, long>> top = balances.top(10);
+	const int BUCKETS = 10;
+	int64_t width = (summary.max - summary.min) / BUCKETS + 1;
+	vector<long> spread = balances.histogram(summary.min, width, BUCKETS);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - began).count();
+
+	if (summary.accounts == 0)
+	{
+		cout << "\nNo accounts in the file" << endl;
+		return;
+	}
+	cout << "\n****Balance Report****" << endl;
+	cout << "Accounts: " << summary.accounts << endl;
+	cout << "Total Deposits: Rs. " << format_cents(summary.total) << endl;
+	cout << "Lowest Balance: Rs. " << format_cents(summary.min) << endl;
+	cout << "Highest Balance: Rs. " << format_cents(summary.max) << endl;
+	cout << "Overdrawn Accounts: " << overdrawn << endl;
+	cout << "\nLargest Balances" << endl;
+	vector<long> top_slots;
+	for (const auto& t : top) top_slots.push_back(t.second);
+	vector<account_record> top_recs(top.size());
+	vector<char> ok(top.size(), 0);
+	store.read_batch(top_slots.data(), top_slots.size(), top_recs.data(), [&ok](size_t i, bool read) { ok[i] = read; });
+	for (size_t i = 0; i < top.size(); i++)
+	{
+		if (!ok[i]) continue;
+		const account_record& rec = top_recs[i];
+		cout << " " << i + 1 << ". " << rec.account_number << " " << rec.firstName << " " << rec.lastName
+			<< ": Rs. " << format_cents(top[i].first) << endl;
+	}
+	cout << "\nBalance Spread" << endl;
+	for (int b = 0; b < BUCKETS; b++)
+	{
+		cout << " Rs. " << format_cents(summary.min + b * width) << " - " << format_cents(summary.min + (b + 1) * width - 1)
+			<< ": " << spread[b] << endl;
+	}
+	cout << "\nReport computed in " << ms << " ms" << endl;
+	cout << "--------------------------------------" << endl;
+}
+
+//read an amount of money, false when it is not a positive amount
+bool account_query::ask_amount(int64_t& cents) {
+	string amount;
+	cout << "Enter Amount: ";
+	cin >> amount;
+	if (!parse_cents(amount.c_str(), cents) || cents <= 0)
+	{
+		cout << "\nEnter the Amount as a positive number with at most 2 decimals" << endl;
+		return false;
+	}
+	return true;
+}
+
+void account_query::deposit_rec() {
+	char number[20];
+	int64_t cents;
+	cout << "\n Enter Account Number to Deposit to: ";
+	cin >> number;
+	if (!ask_amount(cents)) return;
+	cout << "\n" << txn_message(engine.deposit(number, cents)) << endl;
+}
+
+void account_query::withdraw_rec() {
+	char number[20];
+	int64_t cents;
+	cout << "\n Enter Account Number to Withdraw from: ";
+	cin >> number;
+	if (!ask_amount(cents)) return;
+	cout << "\n" << txn_message(engine.withdraw(number, cents)) << endl;
+}
+
+//move money between two accounts, both change or neither does
+void account_query::transfer_rec() {
+	char from[20], to[20];
+	int64_t cents;
+	cout << "\n Enter Account Number to Transfer from: ";
+	cin >> from;
+	cout << " Enter Account Number to Transfer to: ";
+	cin >> to;
+	if (!ask_amount(cents)) return;
+	cout << "\n" << txn_message(engine.transfer(from, to, cents)) << endl;
+}
+
+//open record.bank with its free list, log, record.idx and record.names. the
+//indexes are rebuilt if record.bank was changed without them or a crash left
+//entries in the log
+void account_query::open_store() {
+	if (!store.open("record.bank", "record.free", "record.wal", "record.bal"))
 	{
-		infile.read(reinterpret_cast<char*>(this), sizeof(*this));
-		if (i == (n - 1))
-			continue;
-		tmpfile.write(reinterpret_cast<char*>(this), sizeof(*this));
+		cout << "\nError in opening! record.bank, or it is in use by another program" << endl;
+		exit(1);
 	}
-	infile.close();
-	tmpfile.close();
-	remove("record.bank");
-	rename("tmpfile.bank", "record.bank");
+	if (!index.open("record.idx") || !names.open("record.names"))
+	{
+		cout << "\nError in opening! record.idx or record.names" << endl;
+		exit(1);
+	}
+	if (store.recovered_entries() > 0)
+		cout << "\nRecovered " << store.recovered_entries() << " logged write(s) after a crash" << endl;
+	if (store.recovered_entries() > 0 || store.count() != index.records() ||
+		!names.is_valid() || store.count() != names.records())
+		rebuild_index();
+}
+
+//make the writes of the last operation durable
+void account_query::commit_store() {
+	store.commit();
+}
+
+//write everything back to record.bank, empty the log and save the name
+//index before quitting
+void account_query::close_store() {
+	store.checkpoint();
+	names.save();
+}
+
+//rebuild record.idx and the name index from a full pass over record.bank
+void account_query::rebuild_index() {
+	vector<index_entry> entries;
+	vector<name_entry> by_name;
+	store.scan([&entries, &by_name](long slot, const account_record& rec) {
+		index_entry entry;
+		memset(&entry, 0, sizeof(entry));
+		memcpy(entry.account_number, rec.account_number, INDEX_KEY_SIZE);
+		entry.record = (int32_t)slot;
+		entries.push_back(entry);
+		by_name.push_back(name_index::make_entry(rec.lastName, rec.firstName, slot));
+		});
+	index.rebuild(entries, store.count());
+	names.rebuild(by_name, store.count());
+}
+
+//run the transaction engine flat out on a scratch store of generated accounts
+//and report its throughput and latency. the files are removed afterwards
+int account_query::load_test(int argc, char** argv) {
+	const char* files[] = { "loadtest.bank", "loadtest.free", "loadtest.wal", "loadtest.bal", "loadtest.idx" };
+	long accounts = argc > 2 ? atol(argv[2]) : 100000;
+	load_options opt;
+	if (argc > 3) opt.threads = atoi(argv[3]);
+	if (argc > 4) opt.transactions = atol(argv[4]);
+	if (argc > 5) opt.transfer_percent = atoi(argv[5]);
+	if (argc > 6) opt.readers = atoi(argv[6]);
+	if (accounts < 2 || opt.threads < 1 || opt.transactions < 1 || opt.transfer_percent < 0 || opt.transfer_percent > 100 ||
+		opt.readers < 0)
+	{
+		cerr << "usage: " << argv[0] << " --load-test [accounts] [threads] [transactions per thread] [transfer %] [report threads]" << endl;
+		return 2;
+	}
+
+	for (const char* f : files) remove(f);
+	load_result result;
+	pool_stats cache;
+	{
+		record_store scratch;
+		account_index scratch_index;
+		if (!scratch.open(files[0], files[1], files[2], files[3]) || !scratch_index.open(files[4]))
+		{
+			cerr << "Error in opening! loadtest.bank" << endl;
+			return 1;
+		}
+		vector<account_record> recs(accounts);
+		vector<int64_t> cents(accounts, 100000);
+		vector<index_entry> entries(accounts);
+		for (long i = 0; i < accounts; i++)
+		{
+			memset(&recs[i], 0, sizeof(recs[i]));
+			snprintf(recs[i].account_number, sizeof(recs[i].account_number), "LT%d", (int)i);
+			strcpy(recs[i].firstName, "Load");
+			strcpy(recs[i].lastName, "Test");
+			recs[i].total_Balance = 1000.0f;
+			memset(&entries[i], 0, sizeof(entries[i]));
+			memcpy(entries[i].account_number, recs[i].account_number, INDEX_KEY_SIZE);
+			entries[i].record = (int32_t)i;
+		}
+		scratch.append_unlogged(recs.data(), cents.data(), accounts);
+		scratch.checkpoint();
+		scratch_index.rebuild(entries, accounts);
+
+		transaction_engine scratch_engine(scratch, scratch_index);
+		transaction_load load(scratch, scratch_engine);
+		load.run(opt, result);
+		scratch.checkpoint();
+		cache = scratch.cache_stats();
+	}
+	for (const char* f : files) remove(f);
+
+	cerr << result.transactions << " transaction(s) on " << accounts << " accounts from " << opt.threads
+		<< " thread(s) in " << result.seconds << " s";
+	if (result.seconds > 0) cerr << " (" << (long long)(result.transactions / result.seconds) << " transactions/s)";
+	cerr << endl;
+	cerr << "latency us: p50 " << result.p50_us << ", p99 " << result.p99_us << ", p99.9 " << result.p999_us
+		<< ", max " << result.max_us << endl;
+	cerr << "refused for lack of funds: " << result.refused << endl;
+	cerr << "buffer pool: " << cache.hits << " hits, " << cache.misses << " misses, " << cache.page_writes
+		<< " pages written back in " << cache.file_writes << " writes" << endl;
+	if (opt.readers > 0)
+	{
+		cerr << "snapshot reports: " << result.snapshots << " scan(s), " << result.torn_rows << " inconsistent row(s)";
+		if (opt.transfer_percent == 100) cerr << ", " << result.unbalanced_scans << " scan(s) with a wrong total";
+		cerr << endl;
+	}
+	bool balanced = result.total_after == result.total_before + result.net_deposits;
+	cerr << "total balance " << format_cents(result.total_before) << " -> " << format_cents(result.total_after)
+		<< (balanced ? ", matches the net deposits" : ", DOES NOT match the net deposits") << endl;
+	return balanced && result.torn_rows == 0 && result.unbalanced_scans == 0 ? 0 : 1;
+}
+
+//fill scratch files with accounts and run a mix of record operations on
+//them from several threads, reporting throughput, latency and I/O per kind
+int account_query::benchmark(int argc, char** argv) {
+	const char* files[] = { "bench.bank", "bench.free", "bench.wal", "bench.bal", "bench.idx", "bench.names" };
+	long accounts = argc > 2 ? atol(argv[2]) : 100000;
+	bench_options opt;
+	if (argc > 3) opt.threads = atoi(argv[3]);
+	if (argc > 4) opt.operations = atol(argv[4]);
+	bool mix_ok = true;
+	if (argc > 5)
+	{
+		const char* at = argv[5];
+		for (int op = 0; op < BENCH_OPS && mix_ok; op++)
+		{
+			char* end;
+			opt.mix[op] = (int)strtol(at, &end, 10);
+			mix_ok = end != at && (*end == (op == BENCH_OPS - 1 ? '\0' : ','));
+			at = end + 1;
+		}
+	}
+	int total = 0;
+	for (int op = 0; op < BENCH_OPS; op++) total += opt.mix[op] < 0 ? 1000 : opt.mix[op];
+	if (accounts < 1 || accounts > INT32_MAX || opt.threads < 1 || opt.operations < 1 || !mix_ok || total != 100)
+	{
+		cerr << "usage: " << argv[0] << " --bench [accounts] [threads] [operations per thread] [create,read,find,edit,delete,scan %]" << endl;
+		cerr << "\tthe mix is 6 percentages adding up to 100, 5,40,40,10,4,1 by default" << endl;
+		return 2;
+	}
+
+	for (const char* f : files) remove(f);
+	bench_result result;
+	pool_stats cache;
+	{
+		record_store scratch;
+		account_index scratch_index;
+		name_index scratch_names;
+		if (!scratch.open(files[0], files[1], files[2], files[3]) || !scratch_index.open(files[4]) || !scratch_names.open(files[5]))
+		{
+			cerr << "Error in opening! bench.bank" << endl;
+			return 1;
+		}
+		vector<account_record> recs(accounts);
+		vector<int64_t> cents(accounts, 100000);
+		vector<index_entry> entries(accounts);
+		vector<name_entry> name_entries(accounts);
+		for (long i = 0; i < accounts; i++)
+		{
+			memset(&recs[i], 0, sizeof(recs[i]));
+			bench_account_number(i, recs[i].account_number, sizeof(recs[i].account_number));
+			snprintf(recs[i].firstName, sizeof(recs[i].firstName), "F%d", (int)(i % 1000));
+			snprintf(recs[i].lastName, sizeof(recs[i].lastName), "L%d", (int)(i / 1000 % 1000));
+			recs[i].total_Balance = 1000.0f;
+			memset(&entries[i], 0, sizeof(entries[i]));
+			memcpy(entries[i].account_number, recs[i].account_number, INDEX_KEY_SIZE);
+			entries[i].record = (int32_t)i;
+			name_entries[i] = name_index::make_entry(recs[i].lastName, recs[i].firstName, i);
+		}
+		scratch.append_unlogged(recs.data(), cents.data(), accounts);
+		scratch.checkpoint();
+		scratch_index.rebuild(entries, accounts);
+		scratch_names.rebuild(name_entries, accounts);
+
+		store_benchmark bench(scratch, scratch_index, scratch_names, accounts);
+		bench.run(opt, result);
+		scratch.checkpoint();
+		cache = scratch.cache_stats();
+	}
+	for (const char* f : files) remove(f);
+
+	cerr << result.operations << " operation(s) on " << accounts << " accounts from " << opt.threads
+		<< " thread(s) in " << result.seconds << " s";
+	if (result.seconds > 0) cerr << " (" << (long long)(result.operations / result.seconds) << " operations/s)";
+	cerr << endl;
+	char line[160];
+	snprintf(line, sizeof(line), "%-7s %9s %8s %10s %10s %10s %10s %11s %12s",
+		"op", "count", "missed", "p50 us", "p99 us", "p99.9 us", "max us", "read B/op", "written B/op");
+	cerr << line << endl;
+	for (int op = 0; op < BENCH_OPS; op++)
+	{
+		const bench_op_result& r = result.ops[op];
+		if (r.count == 0) continue;
+		snprintf(line, sizeof(line), "%-7s %9ld %8ld %10.1f %10.1f %10.1f %10.1f %11.0f %12.0f",
+			bench_op_name(op), r.count, r.missed, r.p50_us, r.p99_us, r.p999_us, r.max_us,
+			(double)r.bytes_read / r.count, (double)r.bytes_written / r.count);
+		cerr << line << endl;
+	}
+	cerr << "buffer pool: " << cache.hits << " hits, " << cache.misses << " misses, " << cache.page_writes
+		<< " pages written back in " << cache.file_writes << " writes" << endl;
+	return 0;
 }
 
-int main() {
+//bulk import or export from the command line, see usage below
+int account_query::run_batch(int argc, char** argv) {
+	const char* mode = argv[1];
+	if (strcmp(mode, "--load-test") == 0) return load_test(argc, argv);
+	if (strcmp(mode, "--bench") == 0) return benchmark(argc, argv);
+	bool import = strcmp(mode, "--import") == 0 || strcmp(mode, "--import-bin") == 0;
+	bool exporting = strcmp(mode, "--export") == 0 || strcmp(mode, "--export-bin") == 0;
+	bool binary = strstr(mode, "-bin") != nullptr;
+	if (argc != 3 || (!import && !exporting))
+	{
+		cerr << "usage: " << argv[0] << " [--import | --import-bin | --export | --export-bin] <file>" << endl;
+		cerr << "\t--import      append accounts from a csv file" << endl;
+		cerr << "\t--import-bin  append raw records in the record.bank layout" << endl;
+		cerr << "\t--export      write every account as csv" << endl;
+		cerr << "\t--export-bin  write every account as raw records" << endl;
+		cerr << "\tuse - as the file for stdin or stdout" << endl;
+		cerr << "   or: " << argv[0] << " --load-test [accounts] [threads] [transactions per thread] [transfer %] [report threads]" << endl;
+		cerr << "   or: " << argv[0] << " --bench [accounts] [threads] [operations per thread] [create,read,find,edit,delete,scan %]" << endl;
+		return 2;
+	}
+
+	bool standard = strcmp(argv[2], "-") == 0;
+	FILE* file = standard ? (import ? stdin : stdout) : fopen(argv[2], import ? "rb" : "wb");
+	if (file == nullptr)
+	{
+		cerr << "Error in opening! " << argv[2] << endl;
+		return 1;
+	}
+#ifdef _WIN32
+	if (standard) _setmode(_fileno(file), _O_BINARY);
+#endif
+
+	bulk_transfer transfer(store);
+	bulk_result result;
+	if (import)
+	{
+		result = binary ? transfer.import_binary(file) : transfer.import_csv(file);
+		rebuild_index();
+	}
+	else
+		result = binary ? transfer.export_binary(file) : transfer.export_csv(file);
+	if (!standard && fclose(file) != 0 && exporting) result.failed = true;
+	if (result.failed)
+	{
+		cerr << "Error in writing! " << argv[2] << endl;
+		return 1;
+	}
+
+	cerr << (import ? "Imported " : "Exported ") << result.records << " record(s)";
+	if (import) cerr << ", skipped " << result.skipped;
+	cerr << " in " << result.seconds << " s";
+	if (result.seconds > 0) cerr << " (" << (long long)(result.records / result.seconds) << " records/s)";
+	cerr << endl;
+	return 0;
+}
+
+int main(int argc, char** argv) {
 	account_query A;
 	int choice;
+	if (argc > 1)
+	{
+		A.open_store();
+		int status = A.run_batch(argc, argv);
+		A.close_store();
+		return status;
+	}
 	cout << "***Account Information System***" << endl;
+	A.open_store();
 
 	while (true)
 	{
@@ -164,7 +630,14 @@ int main() {
 		cout << "\n\t3-->Search Record from file";
 		cout << "\n\t4-->Update Record";
 		cout << "\n\t5-->Delete Record";
-		cout << "\n\t6-->Quit";
+		cout << "\n\t6-->Search Record by Account Number";
+		cout << "\n\t7-->Compact Record File";
+		cout << "\n\t8-->Balance Report";
+		cout << "\n\t9-->Deposit";
+		cout << "\n\t10-->Withdraw";
+		cout << "\n\t11-->Transfer";
+		cout << "\n\t12-->Search Record by Name";
+		cout << "\n\t13-->Quit";
 		cout << "\nEnter you choice: ";
 		cin >> choice;
 
@@ -186,12 +659,36 @@ int main() {
 			A.delete_rec();
 			break;
 		case 6:
+			A.search_acc();
+			break;
+		case 7:
+			A.compact_rec();
+			break;
+		case 8:
+			A.balance_report();
+			break;
+		case 9:
+			A.deposit_rec();
+			break;
+		case 10:
+			A.withdraw_rec();
+			break;
+		case 11:
+			A.transfer_rec();
+			break;
+		case 12:
+			A.search_name();
+			break;
+		case 13:
+			A.close_store();
 			exit(0);
 			break;
 		default:
 			cout << "\nEnter correct choice";
+			A.close_store();
 			exit(0);
 		}
+		A.commit_store();
 	}
 	system("pause");
 	return 0;
@@ -0,0 +1,398 @@
+//cache of 4 KiB pages of a block_file. reads and writes are copied in and out
+//of the cached pages, so repeated access to the same records never reaches
+//the file system. changed pages are only marked dirty. flush() writes them
+//back together, sorted by page and with neighbouring pages merged into one
+//write; a dirty page that has to be evicted is written back on its own.
+//
+//pages are replaced with the CLOCK algorithm: every access sets the page's
+//reference bit, and the hand clears reference bits until it finds a page
+//without one.
+//
+//every write carries the lsn of its log entry. before a page goes to the file
+//the log is made durable up to the highest lsn on it, so the file never holds
+//a change the log could not replay.
+//
+//with use_async_io() the runs of one write back are all put in flight at once
+//instead of written one after the other, see asyncIO.h
+//
+//the pool lock is let go for every read and write of the file and for
+//making the log durable. a page being read in is marked loading and whoever
+//needs it waits for it. a page being written back is copied out first and
+//stays in its frame until the write is done, so it can be read and changed
+//meanwhile but is neither evicted nor read in again from a stale file
+
+#ifndef BANK_BUFFERPOOL_H
+#define BANK_BUFFERPOOL_H
+
+#include "asyncIO.h"
+#include "fileIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+const size_t POOL_PAGE_SIZE = 4096;
+
+struct pool_stats
+{
+	long long hits = 0;
+	long long misses = 0;
+	long long page_writes = 0; //pages written back
+	long long file_writes = 0; //write calls those pages took
+};
+
+class buffer_pool
+{
+private:
+	struct frame
+	{
+		long long page = -1; //page number held, -1 when the frame is empty
+		uint64_t lsn = 0;    //highest lsn of a write not yet on file
+		bool dirty = false;
+		bool referenced = false;
+		bool loading = false; //being read in, its bytes are not there yet
+		bool writing = false; //a copy of it is being written back
+		uint64_t written = 0; //write backs of this frame started so far
+	};
+
+	static const size_t NO_FRAME = (size_t)-1;
+
+	block_file* file = nullptr;
+	std::function<void(uint64_t)> make_durable; //called with an lsn before a write back
+	std::vector<char> memory;
+	std::vector<frame> frames;
+	std::unordered_map<long long, size_t> table; //page number -> frame
+	size_t hand = 0;
+	long long end = 0; //bytes the file holds once written back, the last page is cut there
+	std::mutex lock;
+	std::condition_variable settled; //a frame is done loading or writing
+	pool_stats counters;
+	std::atomic<uint64_t> write_backs{ 0 }; //started so far, see write_back_count
+	async_io writer;
+	std::mutex writer_lock; //an async_io is driven by one thread at a time
+
+	char* data_of(size_t f) { return &memory[f * POOL_PAGE_SIZE]; }
+
+	//pages copied in one go by read and write, so a record across a page
+	//boundary is never seen half written
+	size_t span() const { return std::max<size_t>(frames.size() / 4, 1); }
+
+	//write back the dirty frames in 'dirty', merging runs of consecutive
+	//pages. they are copied out and marked clean with 'held', which is let go
+	//for the I/O
+	void write_back(std::vector<size_t>& dirty, std::unique_lock<std::mutex>& held) {
+		std::sort(dirty.begin(), dirty.end(), [this](size_t a, size_t b) { return frames[a].page < frames[b].page; });
+		std::vector<char> copy(dirty.size() * POOL_PAGE_SIZE);
+		std::vector<uint64_t> lsns(dirty.size());
+		std::vector<io_request> writes;
+		uint64_t lsn = 0;
+		for (size_t i = 0; i < dirty.size(); )
+		{
+			size_t j = i + 1;
+			while (j < dirty.size() && frames[dirty[j]].page == frames[dirty[j - 1]].page + 1) j++;
+			io_request w;
+			w.write = true;
+			w.fd = file->handle();
+			w.buf = &copy[i * POOL_PAGE_SIZE];
+			w.offset = frames[dirty[i]].page * (long long)POOL_PAGE_SIZE;
+			w.length = (uint32_t)std::min<long long>((long long)((j - i) * POOL_PAGE_SIZE), end - w.offset);
+			w.tag = writes.size();
+			writes.push_back(w);
+			counters.page_writes += (long long)(j - i);
+			counters.file_writes++;
+			i = j;
+		}
+		for (size_t i = 0; i < dirty.size(); i++)
+		{
+			frame& fr = frames[dirty[i]];
+			memcpy(&copy[i * POOL_PAGE_SIZE], data_of(dirty[i]), POOL_PAGE_SIZE);
+			lsns[i] = fr.lsn;
+			lsn = std::max(lsn, fr.lsn);
+			fr.dirty = false;
+			fr.lsn = 0;
+			fr.writing = true;
+			fr.written++;
+		}
+		write_backs++;
+
+		held.unlock();
+		try
+		{
+			if (make_durable && lsn > 0) make_durable(lsn);
+			if (writer.is_open())
+			{
+				//a write that came back short or failed is done again in line,
+				//where a real error throws
+				std::vector<size_t> retry;
+				{
+					std::lock_guard<std::mutex> driving(writer_lock);
+					writer.run(writes.data(), writes.size(), [&](const io_completion& c) {
+						if (c.result != (long long)writes[c.tag].length) retry.push_back((size_t)c.tag);
+						});
+				}
+				for (size_t r : retry) file->write_at(writes[r].buf, writes[r].length, writes[r].offset);
+			}
+			else
+			{
+				for (const io_request& w : writes) file->write_at(w.buf, w.length, w.offset);
+			}
+		}
+		catch (...)
+		{
+			held.lock();
+			for (size_t i = 0; i < dirty.size(); i++)
+			{
+				frame& fr = frames[dirty[i]];
+				fr.writing = false;
+				fr.dirty = true;
+				fr.lsn = std::max(fr.lsn, lsns[i]);
+			}
+			settled.notify_all();
+			throw;
+		}
+		held.lock();
+		for (size_t f : dirty) frames[f].writing = false;
+		settled.notify_all();
+	}
+
+	//an empty frame taken with the clock hand. a dirty pick is written back
+	//on its own first, which lets go of 'held', and NO_FRAME is returned so
+	//the caller looks again; the same when every frame is busy and this had
+	//to wait for one
+	size_t victim(std::unique_lock<std::mutex>& held) {
+		for (size_t looked = 0; looked < 2 * frames.size(); looked++)
+		{
+			frame& fr = frames[hand];
+			size_t f = hand;
+			hand = (hand + 1) % frames.size();
+			if (fr.page < 0) return f;
+			if (fr.loading || fr.writing) continue;
+			if (fr.referenced)
+			{
+				fr.referenced = false;
+				continue;
+			}
+			if (fr.dirty)
+			{
+				std::vector<size_t> one(1, f);
+				write_back(one, held);
+				return NO_FRAME;
+			}
+			table.erase(fr.page);
+			fr.page = -1;
+			return f;
+		}
+		settled.wait(held);
+		return NO_FRAME;
+	}
+
+	//bring a page into a frame, reading it in with 'held' let go, true if
+	//this call read it. a page past the end of the file comes in as zeros
+	bool fetch(long long page, std::unique_lock<std::mutex>& held) {
+		while (true)
+		{
+			auto it = table.find(page);
+			if (it != table.end())
+			{
+				if (!frames[it->second].loading) return false;
+				settled.wait(held);
+				continue;
+			}
+			size_t f = victim(held);
+			if (f == NO_FRAME) continue;
+
+			frames[f].page = page;
+			frames[f].referenced = true;
+			frames[f].loading = true;
+			table[page] = f;
+			held.unlock();
+			try
+			{
+				size_t got = file->read_at(data_of(f), POOL_PAGE_SIZE, page * (long long)POOL_PAGE_SIZE);
+				memset(data_of(f) + got, 0, POOL_PAGE_SIZE - got);
+			}
+			catch (...)
+			{
+				held.lock();
+				table.erase(page);
+				frames[f].page = -1;
+				frames[f].loading = false;
+				settled.notify_all();
+				throw;
+			}
+			held.lock();
+			frames[f].loading = false;
+			settled.notify_all();
+			return true;
+		}
+	}
+
+	//call part(frame, offset in page, bytes done, bytes) for every page of the
+	//n bytes at 'offset', with the pages of each span() of them all in at once
+	template <class F>
+	void each_page(size_t n, long long offset, std::unique_lock<std::mutex>& held, F part) {
+		if (n == 0) return;
+		long long last = (offset + (long long)n - 1) / (long long)POOL_PAGE_SIZE;
+		std::vector<size_t> got;
+		std::vector<bool> missed;
+		for (long long first = offset / (long long)POOL_PAGE_SIZE; first <= last; first += (long long)got.size())
+		{
+			long long pages = std::min<long long>((long long)span(), last - first + 1);
+			got.resize((size_t)pages);
+			missed.assign((size_t)pages, false);
+			//a fetch can let go of the lock and lose a page found before it,
+			//so they are looked up again until none of them had to be fetched
+			for (bool fetched = true; fetched; )
+			{
+				fetched = false;
+				for (long long k = 0; k < pages && !fetched; k++)
+				{
+					auto it = table.find(first + k);
+					if (it == table.end() || frames[it->second].loading)
+					{
+						if (fetch(first + k, held)) missed[(size_t)k] = true;
+						fetched = true;
+					}
+					else got[(size_t)k] = it->second;
+				}
+			}
+			for (long long k = 0; k < pages; k++)
+			{
+				long long page_at = (first + k) * (long long)POOL_PAGE_SIZE;
+				long long from = std::max(offset, page_at);
+				long long to = std::min(offset + (long long)n, page_at + (long long)POOL_PAGE_SIZE);
+				frames[got[(size_t)k]].referenced = true;
+				if (missed[(size_t)k]) counters.misses++;
+				else counters.hits++;
+				part(got[(size_t)k], (size_t)(from - page_at), (size_t)(from - offset), (size_t)(to - from));
+			}
+		}
+	}
+
+	//wait until no frame is being read in or written back
+	void settle(std::unique_lock<std::mutex>& held) {
+		for (size_t f = 0; f < frames.size(); )
+		{
+			if (frames[f].loading || frames[f].writing)
+			{
+				settled.wait(held);
+				f = 0;
+			}
+			else f++;
+		}
+	}
+
+public:
+	//cache 'pages' pages of 'f'. 'durable' is called with an lsn that has to be
+	//on disk before pages written with it can be written back
+	void open(block_file& f, size_t pages, std::function<void(uint64_t)> durable) {
+		std::unique_lock<std::mutex> held(lock);
+		settle(held);
+		file = &f;
+		make_durable = durable;
+		memory.assign(std::max<size_t>(pages, 8) * POOL_PAGE_SIZE, 0);
+		frames.assign(std::max<size_t>(pages, 8), frame());
+		table.clear();
+		hand = 0;
+		end = f.size();
+	}
+
+	//write back through an async_io with 'depth' writes in flight
+	void use_async_io(unsigned depth) {
+		std::lock_guard<std::mutex> driving(writer_lock);
+		writer.open(depth, 2);
+	}
+
+	//true when any page of the n bytes at 'offset' is in the cache, so reading
+	//them around the cache could miss a change
+	bool cached(size_t n, long long offset) {
+		std::lock_guard<std::mutex> guard(lock);
+		for (long long page = offset / (long long)POOL_PAGE_SIZE; page * (long long)POOL_PAGE_SIZE < offset + (long long)n; page++)
+		{
+			if (table.count(page) > 0) return true;
+		}
+		return false;
+	}
+
+	//write backs started so far. bytes that cached() said were not held and
+	//that were then read from the file around the cache are what the cache
+	//would have given, as long as this has not moved by the end of the read
+	uint64_t write_back_count() const { return write_backs.load(); }
+
+	//copy n bytes at a file offset out of the cache
+	void read(void* dst, size_t n, long long offset) {
+		std::unique_lock<std::mutex> held(lock);
+		each_page(n, offset, held, [&](size_t f, size_t in_page, size_t done, size_t part) {
+			memcpy((char*)dst + done, data_of(f) + in_page, part);
+			});
+	}
+
+	//copy n bytes into the cache at a file offset and mark the pages dirty
+	void write(const void* src, size_t n, long long offset, uint64_t lsn) {
+		std::unique_lock<std::mutex> held(lock);
+		end = std::max(end, offset + (long long)n);
+		each_page(n, offset, held, [&](size_t f, size_t in_page, size_t done, size_t part) {
+			memcpy(data_of(f) + in_page, (const char*)src + done, part);
+			frames[f].dirty = true;
+			frames[f].lsn = std::max(frames[f].lsn, lsn);
+			});
+	}
+
+	//write every page that is dirty when this is called to the file, the
+	//file is not synced. pages changed meanwhile may or may not go with them
+	void flush() {
+		std::unique_lock<std::mutex> held(lock);
+		//each dirty frame needs a write back started from here on, and that
+		//one done: the frame's write back count has to get past 'after'
+		struct owed_frame
+		{
+			size_t f;
+			uint64_t after;
+		};
+		std::vector<owed_frame> owed;
+		for (size_t f = 0; f < frames.size(); f++)
+		{
+			if (frames[f].dirty) owed.push_back({ f, frames[f].written });
+		}
+		while (!owed.empty())
+		{
+			std::vector<size_t> batch;
+			size_t kept = 0;
+			for (const owed_frame& o : owed)
+			{
+				const frame& fr = frames[o.f];
+				//clean and still, or a write back started since is done
+				if ((!fr.dirty && !fr.writing) || fr.written > o.after + (fr.writing ? 1 : 0)) continue;
+				if (fr.dirty && !fr.writing) batch.push_back(o.f);
+				owed[kept++] = o;
+			}
+			owed.resize(kept);
+			if (!batch.empty()) write_back(batch, held);
+			else if (!owed.empty()) settled.wait(held);
+		}
+	}
+
+	//drop every cached page without writing it, for when the file underneath
+	//is replaced
+	void clear() {
+		std::unique_lock<std::mutex> held(lock);
+		settle(held);
+		frames.assign(frames.size(), frame());
+		table.clear();
+		hand = 0;
+		end = file->size();
+	}
+
+	pool_stats stats() {
+		std::lock_guard<std::mutex> guard(lock);
+		return counters;
+	}
+};
+
+#endif //BANK_BUFFERPOOL_H
@@ -0,0 +1,361 @@
+//non interactive import and export of whole account books. input is streamed
+//through large buffers and appended to record.bank a few thousand records per
+//write, with a single fsync when the import is done. two formats are read and
+//written:
+//	csv	account_number,firstName,lastName,total_Balance, one account per line.
+//		a field holding a comma, a quote or a line break is put in quotes,
+//		with the quotes in it doubled
+//	binary	raw 44 byte account_record images, the record.bank layout
+
+#ifndef BANK_BULKTRANSFER_H
+#define BANK_BULKTRANSFER_H
+
+#include "recordStore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+struct bulk_result
+{
+	long records = 0; //records imported or exported
+	long skipped = 0; //input lines or records that were rejected
+	bool failed = false; //an export could not be written in full
+	double seconds = 0;
+};
+
+//open addressing set of account numbers, kept flat so a few million
+//lookups do not turn into a few million node allocations and pointer chases
+class account_number_set
+{
+private:
+	typedef char key[20];
+	std::vector<char> slots; //20 bytes per slot, an empty account number marks a free one
+	size_t mask = 0;
+	size_t used = 0;
+
+	static uint64_t hash_key(const char* k) {
+		uint64_t h = 14695981039346656037ULL; //FNV-1a
+		for (int i = 0; i < 20 && k[i] != '\0'; i++)
+		{
+			h ^= (unsigned char)k[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+	void grow() {
+		std::vector<char> old;
+		old.swap(slots);
+		size_t capacity = old.empty() ? 1024 : (mask + 1) * 2;
+		slots.assign(capacity * sizeof(key), 0);
+		mask = capacity - 1;
+		used = 0;
+		for (size_t i = 0; i < old.size(); i += sizeof(key))
+		{
+			if (old[i] != '\0') insert(&old[i]);
+		}
+	}
+
+public:
+	void clear() {
+		slots.clear();
+		mask = used = 0;
+	}
+
+	//add an account number, false if it was already there
+	bool insert(const char* account_number) {
+		if ((used + 1) * 2 > mask + 1 || slots.empty()) grow();
+		for (size_t i = hash_key(account_number) & mask; ; i = (i + 1) & mask)
+		{
+			char* slot = &slots[i * sizeof(key)];
+			if (slot[0] == '\0')
+			{
+				strncpy(slot, account_number, sizeof(key));
+				used++;
+				return true;
+			}
+			if (strncmp(slot, account_number, sizeof(key)) == 0) return false;
+		}
+	}
+};
+
+class bulk_transfer
+{
+private:
+	//records per write to record.bank and bytes per read or write of the stream
+	const long WRITE_BATCH = 8192;
+	const size_t STREAM_BUFFER = 1 << 20;
+
+	record_store& store;
+	account_number_set known; //account numbers already in the store or the input
+	std::vector<account_record> batch;
+	std::vector<int64_t> batch_cents; //balance of each batched record
+	bulk_result result;
+
+	void start() {
+		result = bulk_result();
+		known.clear();
+		store.scan([this](long, const account_record& rec) {
+			known.insert(rec.account_number);
+			});
+		batch.clear();
+		batch.reserve(WRITE_BATCH);
+		batch_cents.clear();
+		batch_cents.reserve(WRITE_BATCH);
+	}
+
+	//queue one record, rejecting account numbers seen before
+	void add(const account_record& rec, int64_t cents) {
+		if (is_free(rec) || !known.insert(rec.account_number))
+		{
+			result.skipped++;
+			return;
+		}
+		batch.push_back(rec);
+		batch_cents.push_back(cents);
+		if ((long)batch.size() == WRITE_BATCH) flush();
+	}
+
+	void flush() {
+		if (batch.empty()) return;
+		store.append_unlogged(batch.data(), batch_cents.data(), (long)batch.size());
+		result.records += (long)batch.size();
+		batch.clear();
+		batch_cents.clear();
+	}
+
+	//write 'n' items of 'size' bytes to an export. after a short write the
+	//rest is not attempted and the result is marked failed
+	void put(FILE* out, const void* data, size_t size, size_t n) {
+		if (n == 0 || result.failed) return;
+		if (fwrite(data, size, n, out) != n) result.failed = true;
+	}
+
+	bulk_result finish(std::chrono::steady_clock::time_point began) {
+		flush();
+		store.checkpoint();
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+		return result;
+	}
+
+	//copy the csv field at 'p' into a fixed size char array, undoing its
+	//quotes if it has them, and leave 'p' on the comma after it or at 'end'.
+	//false if it is empty, does not fit or is badly quoted
+	static bool read_field(const char*& p, const char* end, char* dst, size_t size) {
+		size_t n = 0;
+		if (p < end && *p == '"')
+		{
+			p++;
+			while (true)
+			{
+				if (p == end) return false;
+				char c = *p++;
+				if (c == '"')
+				{
+					if (p == end || *p != '"') break;
+					p++;
+				}
+				if (n + 1 >= size) return false;
+				dst[n++] = c;
+			}
+			if (p < end && *p != ',') return false;
+		}
+		else
+		{
+			const char* comma = (const char*)memchr(p, ',', end - p);
+			const char* stop = comma ? comma : end;
+			n = (size_t)(stop - p);
+			if (n >= size) return false;
+			memcpy(dst, p, n);
+			p = stop;
+		}
+		if (n == 0) return false;
+		memset(dst + n, 0, size - n);
+		return true;
+	}
+
+	//write a text field of at most 'size' chars at 'out' and return its
+	//length, in quotes if it holds a comma, a quote or a line break
+	static size_t put_field(char* out, const char* field, size_t size) {
+		size_t n = strnlen(field, size);
+		bool quote = false;
+		for (size_t i = 0; i < n && !quote; i++)
+			quote = field[i] == ',' || field[i] == '"' || field[i] == '\n' || field[i] == '\r';
+		if (!quote)
+		{
+			memcpy(out, field, n);
+			return n;
+		}
+		char* o = out;
+		*o++ = '"';
+		for (size_t i = 0; i < n; i++)
+		{
+			if (field[i] == '"') *o++ = '"';
+			*o++ = field[i];
+		}
+		*o++ = '"';
+		return (size_t)(o - out);
+	}
+
+	//the newline ending the csv line at 'p', skipping the ones inside quotes,
+	//nullptr if there is none before 'end'
+	static const char* line_end(const char* p, const char* end) {
+		const char* nl = (const char*)memchr(p, '\n', end - p);
+		if (memchr(p, '"', (nl ? nl : end) - p) == nullptr) return nl;
+		bool quoted = false;
+		for (; p < end; p++)
+		{
+			if (*p == '"') quoted = !quoted;
+			else if (*p == '\n' && !quoted) return p;
+		}
+		return nullptr;
+	}
+
+	//parse "account_number,firstName,lastName,total_Balance". the balance is
+	//read as exact cents, so it can have at most two decimals
+	static bool parse_line(const char* line, const char* end, account_record& rec, int64_t& cents) {
+		char number[32];
+		const char* p = line;
+		if (!read_field(p, end, rec.account_number, sizeof(rec.account_number)) || p++ == end ||
+			!read_field(p, end, rec.firstName, sizeof(rec.firstName)) || p++ == end ||
+			!read_field(p, end, rec.lastName, sizeof(rec.lastName)) || p++ == end ||
+			!read_field(p, end, number, sizeof(number)) || p != end)
+			return false;
+		if (!parse_cents(number, cents)) return false;
+		rec.total_Balance = (float)((double)cents / 100.0);
+		return true;
+	}
+
+public:
+	bulk_transfer(record_store& s) : store(s) {}
+
+	//append every valid line of a csv stream. a first line starting with
+	//"account_number" is taken as a header. bad lines and duplicate account
+	//numbers are counted as skipped
+	bulk_result import_csv(FILE* in) {
+		auto began = std::chrono::steady_clock::now();
+		start();
+		std::vector<char> buf(STREAM_BUFFER);
+		size_t kept = 0; //bytes of an unfinished line carried to the next read
+		bool first_line = true;
+		while (true)
+		{
+			size_t got = fread(buf.data() + kept, 1, buf.size() - kept, in);
+			size_t filled = kept + got;
+			bool last = got == 0;
+			if (filled == 0) break;
+
+			const char* p = buf.data();
+			const char* end = buf.data() + filled;
+			while (p < end)
+			{
+				const char* nl = line_end(p, end);
+				if (nl == nullptr && !last) break;
+				const char* line_end = nl ? nl : end;
+				const char* trimmed = line_end;
+				if (trimmed > p && trimmed[-1] == '\r') trimmed--;
+
+				if (trimmed > p && !(first_line && strncmp(p, "account_number", 14) == 0))
+				{
+					account_record rec;
+					int64_t cents;
+					if (parse_line(p, trimmed, rec, cents)) add(rec, cents);
+					else result.skipped++;
+				}
+				first_line = false;
+				p = nl ? nl + 1 : end;
+			}
+
+			kept = (size_t)(end - p);
+			if (last) break;
+			if (kept == buf.size())
+			{
+				//a line longer than the buffer can not be a valid record
+				result.skipped++;
+				kept = 0;
+			}
+			else memmove(buf.data(), p, kept);
+		}
+		return finish(began);
+	}
+
+	//append raw account_record images, a trailing partial record is skipped
+	bulk_result import_binary(FILE* in) {
+		auto began = std::chrono::steady_clock::now();
+		start();
+		std::vector<account_record> recs(STREAM_BUFFER / RECORD_SIZE);
+		size_t got;
+		while ((got = fread(recs.data(), RECORD_SIZE, recs.size(), in)) > 0)
+		{
+			for (size_t i = 0; i < got; i++)
+			{
+				//fields read from outside may lack their terminator
+				account_record& rec = recs[i];
+				rec.account_number[sizeof(rec.account_number) - 1] = '\0';
+				rec.firstName[sizeof(rec.firstName) - 1] = '\0';
+				rec.lastName[sizeof(rec.lastName) - 1] = '\0';
+				add(rec, to_cents(rec.total_Balance));
+			}
+		}
+		return finish(began);
+	}
+
+	//write every account as a csv line, with a header line first. balances
+	//come from the cents column so they are written back exactly. a write
+	//or flush that fails marks the result failed
+	bulk_result export_csv(FILE* out) {
+		auto began = std::chrono::steady_clock::now();
+		result = bulk_result();
+		std::vector<char> buf(STREAM_BUFFER);
+		size_t used = (size_t)snprintf(buf.data(), buf.size(), "account_number,firstName,lastName,total_Balance\n");
+		store.scan([&](long slot, const account_record& rec) {
+			if (buf.size() - used < 256)
+			{
+				put(out, buf.data(), 1, used);
+				used = 0;
+			}
+			int64_t cents = store.balance(slot);
+			uint64_t magnitude = cents < 0 ? 0 - (uint64_t)cents : (uint64_t)cents;
+			used += put_field(&buf[used], rec.account_number, sizeof(rec.account_number));
+			buf[used++] = ',';
+			used += put_field(&buf[used], rec.firstName, sizeof(rec.firstName));
+			buf[used++] = ',';
+			used += put_field(&buf[used], rec.lastName, sizeof(rec.lastName));
+			used += (size_t)snprintf(buf.data() + used, buf.size() - used, ",%s%llu.%02u\n",
+				cents < 0 ? "-" : "", (unsigned long long)(magnitude / 100), (unsigned)(magnitude % 100));
+			result.records++;
+			});
+		put(out, buf.data(), 1, used);
+		if (fflush(out) != 0) result.failed = true;
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+		return result;
+	}
+
+	//write every live record as a raw account_record image. a write or
+	//flush that fails marks the result failed
+	bulk_result export_binary(FILE* out) {
+		auto began = std::chrono::steady_clock::now();
+		result = bulk_result();
+		std::vector<account_record> recs;
+		recs.reserve(STREAM_BUFFER / RECORD_SIZE);
+		store.scan([&](long, const account_record& rec) {
+			recs.push_back(rec);
+			if (recs.size() == recs.capacity())
+			{
+				put(out, recs.data(), RECORD_SIZE, recs.size());
+				recs.clear();
+			}
+			result.records++;
+			});
+		put(out, recs.data(), RECORD_SIZE, recs.size());
+		if (fflush(out) != 0) result.failed = true;
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+		return result;
+	}
+};
+
+#endif //BANK_BULKTRANSFER_H
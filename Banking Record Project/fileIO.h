@@ -0,0 +1,189 @@
+//thin wrapper over an OS file handle. it gives the positional reads and writes,
+//truncate and fsync that the record files need and fstream does not offer
+
+#ifndef BANK_FILEIO_H
+#define BANK_FILEIO_H
+
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <mutex>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//bytes the calling thread has read and written through block_file and
+//async_io, so a benchmark can tell what one operation cost in I/O
+struct io_counters
+{
+	long long read = 0;
+	long long written = 0;
+};
+
+inline io_counters& thread_io() {
+	thread_local io_counters counters;
+	return counters;
+}
+
+class block_file
+{
+private:
+	int fd;
+	std::string path;
+#ifdef _WIN32
+	std::mutex seek_lock; //Windows has no pread/pwrite, seek and access as one step
+#endif
+
+	void fail(const char* what) const {
+		throw std::runtime_error(std::string(what) + " failed on " + path);
+	}
+
+public:
+	block_file() : fd(-1) {}
+	~block_file() { close(); }
+
+	block_file(const block_file&) = delete;
+	block_file& operator=(const block_file&) = delete;
+
+	//open the file for reading and writing, creating it when 'create' is set
+	bool open(const char* file_path, bool create = true) {
+		close();
+		path = file_path;
+#ifdef _WIN32
+		fd = _open(file_path, _O_RDWR | _O_BINARY | (create ? _O_CREAT : 0), _S_IREAD | _S_IWRITE);
+#else
+		fd = ::open(file_path, O_RDWR | (create ? O_CREAT : 0), 0644);
+#endif
+		return fd >= 0;
+	}
+
+	void close() {
+		if (fd < 0) return;
+#ifdef _WIN32
+		_close(fd);
+#else
+		::close(fd);
+#endif
+		fd = -1;
+	}
+
+	bool is_open() const { return fd >= 0; }
+	int handle() const { return fd; }
+	const std::string& name() const { return path; }
+
+	long long size() const {
+#ifdef _WIN32
+		struct _stat64 st;
+		if (_fstat64(fd, &st) != 0) fail("stat");
+#else
+		struct stat st;
+		if (fstat(fd, &st) != 0) fail("stat");
+#endif
+		return (long long)st.st_size;
+	}
+
+	//read up to n bytes at 'offset', returns the bytes read (short at end of file)
+	size_t read_at(void* buf, size_t n, long long offset) {
+		size_t done = 0;
+#ifdef _WIN32
+		std::lock_guard<std::mutex> guard(seek_lock);
+		if (_lseeki64(fd, offset, SEEK_SET) < 0) fail("seek");
+#endif
+		while (done < n)
+		{
+#ifdef _WIN32
+			int got = _read(fd, (char*)buf + done, (unsigned)(n - done));
+#else
+			ssize_t got = pread(fd, (char*)buf + done, n - done, offset + done);
+#endif
+			if (got < 0) fail("read");
+			if (got == 0) break;
+			done += got;
+		}
+		thread_io().read += (long long)done;
+		return done;
+	}
+
+	//write n bytes at 'offset', growing the file when needed
+	void write_at(const void* buf, size_t n, long long offset) {
+		size_t done = 0;
+#ifdef _WIN32
+		std::lock_guard<std::mutex> guard(seek_lock);
+		if (_lseeki64(fd, offset, SEEK_SET) < 0) fail("seek");
+#endif
+		while (done < n)
+		{
+#ifdef _WIN32
+			int put = _write(fd, (const char*)buf + done, (unsigned)(n - done));
+#else
+			ssize_t put = pwrite(fd, (const char*)buf + done, n - done, offset + done);
+#endif
+			if (put <= 0) fail("write");
+			done += put;
+		}
+		thread_io().written += (long long)n;
+	}
+
+	void truncate(long long n) {
+#ifdef _WIN32
+		if (_chsize_s(fd, n) != 0) fail("truncate");
+#else
+		if (ftruncate(fd, n) != 0) fail("truncate");
+#endif
+	}
+
+	//take an exclusive lock on the file that is held until it is closed, so a
+	//second process opening it can tell. false if another process holds it
+	bool try_lock() {
+#ifdef _WIN32
+		std::lock_guard<std::mutex> guard(seek_lock);
+		if (_lseeki64(fd, 0, SEEK_SET) < 0) fail("seek");
+		return _locking(fd, _LK_NBLCK, 1) == 0;
+#else
+		return flock(fd, LOCK_EX | LOCK_NB) == 0;
+#endif
+	}
+
+	//flush the file contents to stable storage
+	void sync() {
+#ifdef _WIN32
+		if (_commit(fd) != 0) fail("sync");
+#else
+		if (fsync(fd) != 0) fail("sync");
+#endif
+	}
+};
+
+//put the file at 'from' in place of the one at 'to' in one step, so a crash
+//leaves one or the other. on POSIX the rename is atomic and the directory is
+//synced after it; windows replaces with MoveFileEx and needs 'to' closed
+inline bool replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	if (::rename(from, to) != 0) return false;
+	std::string dir = to;
+	size_t slash = dir.rfind('/');
+	dir = slash == std::string::npos ? "." : slash == 0 ? "/" : dir.substr(0, slash);
+	int d = ::open(dir.c_str(), O_RDONLY);
+	if (d >= 0)
+	{
+		fsync(d);
+		::close(d);
+	}
+	return true;
+#endif
+}
+
+#endif //BANK_FILEIO_H
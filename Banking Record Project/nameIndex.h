@@ -0,0 +1,235 @@
+//secondary index of record.bank on (lastName, firstName), for finding a
+//customer by name without reading every record. names are compared without
+//regard to case.
+//
+//the index is a sorted array of entries, loaded from record.names when the
+//store opens and written back by save(). new entries go to a small sorted
+//set first and removed ones are only marked, and both are merged into the
+//array once the set has grown, so a change costs O(log n) most of the time.
+//a lookup is a binary search in the array and the set followed by a walk
+//over the k matches, O(log n + k).
+//
+//record.names is marked as out of date while the index is in use, so after
+//a crash it is rebuilt from record.bank instead of being trusted
+
+#ifndef BANK_NAMEINDEX_H
+#define BANK_NAMEINDEX_H
+
+#include "accountRecord.h"
+#include "fileIO.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <vector>
+
+const int NAME_LAST_SIZE = 10;
+const int NAME_KEY_SIZE = 20; //lastName then firstName, each padded with zeros
+
+struct name_entry
+{
+	char key[NAME_KEY_SIZE];
+	int32_t record; //slot in record.bank
+};
+
+inline bool operator<(const name_entry& a, const name_entry& b) {
+	int c = memcmp(a.key, b.key, NAME_KEY_SIZE);
+	return c != 0 ? c < 0 : a.record < b.record;
+}
+
+struct name_header
+{
+	char magic[8];   //"NAMEIDX"
+	int64_t entries;
+	int64_t records; //slots in record.bank when the index was saved
+	int32_t clean;   //0 while the index is open and may have unsaved changes
+	int32_t unused;
+};
+
+class name_index
+{
+private:
+	//entries waiting in the set before it is merged into the array
+	const size_t MERGE_AT = 4096;
+
+	block_file file;
+	std::vector<name_entry> sorted;
+	std::vector<char> dead; //1 for entries of 'sorted' that were removed
+	std::set<name_entry> recent;
+	long removed = 0;
+	long record_count = 0;
+	bool loaded = false;
+	bool clean_on_disk = false; //record.names matches the index and says so
+
+	//fold a name into a key field: lower case, cut at the field size, zero padded
+	static void fold(char* dst, const char* name, int size) {
+		int i = 0;
+		for (; i < size && name[i] != '\0'; i++) dst[i] = (char)tolower((unsigned char)name[i]);
+		for (; i < size; i++) dst[i] = '\0';
+	}
+
+	void write_header(bool clean) {
+		name_header h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, "NAMEIDX", 8);
+		h.entries = (int64_t)sorted.size();
+		h.records = record_count;
+		h.clean = clean ? 1 : 0;
+		file.write_at(&h, sizeof(h), 0);
+		file.sync();
+		clean_on_disk = clean;
+	}
+
+	//called before every change, so a crash after it finds the file out of date
+	void touch() {
+		if (clean_on_disk) write_header(false);
+	}
+
+	//fold the set into the array and drop the removed entries
+	void merge() {
+		if (recent.empty() && removed == 0) return;
+		std::vector<name_entry> out;
+		out.reserve(sorted.size() - removed + recent.size());
+		auto r = recent.begin();
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			if (dead[i]) continue;
+			while (r != recent.end() && *r < sorted[i]) out.push_back(*r++);
+			out.push_back(sorted[i]);
+		}
+		out.insert(out.end(), r, recent.end());
+		sorted.swap(out);
+		dead.assign(sorted.size(), 0);
+		recent.clear();
+		removed = 0;
+	}
+
+public:
+	//the index entry of a record, for rebuild()
+	static name_entry make_entry(const char* last_name, const char* first_name, long record) {
+		name_entry e;
+		fold(e.key, last_name, NAME_LAST_SIZE);
+		fold(e.key + NAME_LAST_SIZE, first_name, NAME_KEY_SIZE - NAME_LAST_SIZE);
+		e.record = (int32_t)record;
+		return e;
+	}
+
+	//open record.names, false if it can not be opened. an index that was not
+	//saved cleanly comes up empty and needs rebuild()
+	bool open(const char* path) {
+		if (!file.open(path)) return false;
+		sorted.clear();
+		recent.clear();
+		removed = 0;
+		record_count = 0;
+		name_header h;
+		if (file.size() >= (long long)sizeof(h) && file.read_at(&h, sizeof(h), 0) == sizeof(h) &&
+			memcmp(h.magic, "NAMEIDX", 8) == 0 && h.clean == 1 &&
+			file.size() == (long long)(sizeof(h) + h.entries * sizeof(name_entry)))
+		{
+			sorted.resize((size_t)h.entries);
+			if (!sorted.empty()) file.read_at(sorted.data(), sorted.size() * sizeof(name_entry), sizeof(h));
+			record_count = (long)h.records;
+			loaded = true;
+		}
+		else loaded = false;
+		dead.assign(sorted.size(), 0);
+		write_header(false);
+		return true;
+	}
+
+	//false when record.names was missing, damaged or not saved at the last close
+	bool is_valid() const { return loaded; }
+
+	long records() const { return record_count; }
+
+	void set_records(long n) {
+		touch();
+		record_count = n;
+	}
+
+	long size() const { return (long)(sorted.size() - removed + recent.size()); }
+
+	//replace the whole index with one entry per live record
+	void rebuild(std::vector<name_entry>& entries, long records) {
+		touch();
+		std::sort(entries.begin(), entries.end());
+		sorted.swap(entries);
+		dead.assign(sorted.size(), 0);
+		recent.clear();
+		removed = 0;
+		record_count = records;
+		loaded = true;
+	}
+
+	void insert(const char* last_name, const char* first_name, long record) {
+		touch();
+		recent.insert(make_entry(last_name, first_name, record));
+		if (recent.size() >= MERGE_AT) merge();
+	}
+
+	void erase(const char* last_name, const char* first_name, long record) {
+		touch();
+		name_entry e = make_entry(last_name, first_name, record);
+		if (recent.erase(e) > 0) return;
+		auto it = std::lower_bound(sorted.begin(), sorted.end(), e);
+		size_t i = (size_t)(it - sorted.begin());
+		if (it != sorted.end() && !(e < *it) && !dead[i])
+		{
+			dead[i] = 1;
+			removed++;
+		}
+	}
+
+	//records whose name matches, in name order. 'last_name' is matched whole
+	//unless 'last_prefix' is set. an empty 'first_name' matches any first name,
+	//otherwise it is matched whole unless 'first_prefix' is set. with a partial
+	//last name the first name only filters the entries found for it
+	std::vector<long> find(const char* last_name, bool last_prefix, const char* first_name, bool first_prefix) const {
+		name_entry low = make_entry(last_name, first_name, INT32_MIN);
+		char first_key[NAME_KEY_SIZE - NAME_LAST_SIZE];
+		memcpy(first_key, low.key + NAME_LAST_SIZE, sizeof(first_key));
+		size_t first_length = first_prefix ? strnlen(first_name, sizeof(first_key)) : sizeof(first_key);
+		bool filter_first = last_prefix && first_name[0] != '\0';
+		size_t length;
+		if (first_name[0] == '\0')
+		{
+			memset(low.key + NAME_LAST_SIZE, 0, NAME_KEY_SIZE - NAME_LAST_SIZE);
+			length = last_prefix ? strnlen(last_name, NAME_LAST_SIZE) : NAME_LAST_SIZE;
+		}
+		else if (last_prefix)
+			length = strnlen(last_name, NAME_LAST_SIZE);
+		else
+			length = NAME_LAST_SIZE + first_length;
+		if (last_prefix) memset(low.key + length, 0, NAME_KEY_SIZE - length);
+
+		//walk both sorted sources from the first possible match, in step
+		auto a = std::lower_bound(sorted.begin(), sorted.end(), low);
+		auto b = recent.lower_bound(low);
+		std::vector<long> out;
+		while (true)
+		{
+			while (a != sorted.end() && dead[a - sorted.begin()]) ++a;
+			bool a_ok = a != sorted.end() && memcmp(a->key, low.key, length) == 0;
+			bool b_ok = b != recent.end() && memcmp(b->key, low.key, length) == 0;
+			if (!a_ok && !b_ok) break;
+			const name_entry& e = a_ok && (!b_ok || *a < *b) ? *a++ : *b++;
+			if (!filter_first || memcmp(e.key + NAME_LAST_SIZE, first_key, first_length) == 0)
+				out.push_back(e.record);
+		}
+		return out;
+	}
+
+	//merge and write the index to record.names, marking it clean
+	void save() {
+		merge();
+		name_header h;
+		file.truncate(sizeof(h));
+		if (!sorted.empty()) file.write_at(sorted.data(), sorted.size() * sizeof(name_entry), sizeof(h));
+		write_header(true);
+	}
+};
+
+#endif //BANK_NAMEINDEX_H
@@ -0,0 +1,564 @@
+//fixed size record file with slot reuse. a deleted record is cleared in place
+//and its slot number pushed on a free list kept in a side file, new records
+//take a free slot before the file is grown. compaction rewrites the file
+//without the free slots once enough of them have piled up.
+//every record write goes through the write ahead log first, see writeAheadLog.h.
+//record reads and writes go through a cache of file pages, see bufferPool.h.
+//read_batch reads many slots with all of their reads in flight at once, see
+//asyncIO.h.
+//scans are served from a memory mapped view of the file when it can be
+//mapped, after the cached changes have been written back, see recordView.h. the balances are also kept as exact cents in a
+//column file beside the records, see balanceColumn.h.
+//
+//reads and writes of existing slots may come from many threads at once, each
+//slot being changed by one thread at a time. insert, erase, compact and
+//checkpoint change the layout and need the store to themselves.
+//
+//record_snapshot reads the store as it was at one moment while writers carry
+//on. writes save the rows they replace in a version_store for as long as a
+//snapshot may need them, see versionStore.h
+
+#ifndef BANK_RECORDSTORE_H
+#define BANK_RECORDSTORE_H
+
+#include "accountRecord.h"
+#include "asyncIO.h"
+#include "balanceColumn.h"
+#include "bufferPool.h"
+#include "fileIO.h"
+#include "recordView.h"
+#include "versionStore.h"
+#include "writeAheadLog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+//what the log holds for one record write: the row and its balance in cents
+struct logged_record
+{
+	account_record rec;
+	int64_t cents;
+};
+
+//one slot of a write that has to reach the disk as a whole, see write_many
+struct logged_write
+{
+	int64_t slot;
+	logged_record image;
+};
+
+//log entries holding several logged_write carry this slot number
+const long MULTI_WRITE = -1;
+
+class record_store
+{
+private:
+	//records moved per read when scanning or compacting
+	const int SCAN_BATCH = 1024;
+	//checkpoint once the log grows past this many bytes
+	const long long CHECKPOINT_BYTES = 64LL * 1024 * 1024;
+	//pages of record.bank kept in the buffer pool unless set_pool_pages says otherwise
+	const size_t POOL_PAGES = 1024;
+
+	std::string data_path;
+	block_file data;      //the records
+	block_file free_list; //stack of free slot numbers, int32 each
+	write_ahead_log log;
+	buffer_pool pool;     //cached pages of 'data'
+	async_io reader;      //reads of read_batch that miss the pool
+	std::mutex reader_lock;
+	record_view view;     //remapped only by the layout changing calls
+	balance_column column; //balance of every slot in cents
+	std::atomic<long> slots{ 0 };
+	long free_count = 0;
+	long recovered = 0; //log entries replayed when the store was opened
+
+	//find the free slots again with a pass over the data file
+	void rebuild_free_list() {
+		free_list.truncate(0);
+		free_count = 0;
+		std::vector<account_record> batch(SCAN_BATCH);
+		for (long first = 0; first < slots; first += SCAN_BATCH)
+		{
+			size_t got = data.read_at(batch.data(), (size_t)SCAN_BATCH * RECORD_SIZE, (long long)first * RECORD_SIZE) / RECORD_SIZE;
+			for (size_t i = 0; i < got; i++)
+			{
+				if (is_free(batch[i])) push_free(first + (long)i);
+			}
+		}
+	}
+
+	void push_free(long slot) {
+		int32_t s = (int32_t)slot;
+		free_list.write_at(&s, sizeof(s), (long long)free_count * sizeof(s));
+		free_count++;
+	}
+
+	//column value for a row that only has its float balance
+	static int64_t cents_of(const account_record& rec) {
+		return is_free(rec) ? FREE_BALANCE : to_cents(rec.total_Balance);
+	}
+
+	//bring a column that is missing or out of step with the data file back
+	//to one balance per slot. the exact cents it holds are kept and only the
+	//slots past its end are filled from the float of their rows; a column
+	//longer than the file is cut
+	void rebuild_column() {
+		long have = std::min<long>(column.size(), slots);
+		std::vector<int64_t> cents(column.data(), column.data() + have);
+		cents.resize(slots, FREE_BALANCE);
+		std::vector<account_record> batch(SCAN_BATCH);
+		for (long first = have; first < slots; first += SCAN_BATCH)
+		{
+			size_t got = data.read_at(batch.data(), (size_t)SCAN_BATCH * RECORD_SIZE, (long long)first * RECORD_SIZE) / RECORD_SIZE;
+			for (size_t i = 0; i < got; i++) cents[first + (long)i] = cents_of(batch[i]);
+		}
+		column.reset(cents);
+	}
+
+	//writes hold this shared while they apply, a new snapshot holds it alone
+	//so it starts between two writes and never inside a transfer
+	std::shared_mutex versions_lock;
+	std::atomic<uint64_t> version{ 0 }; //bumped by every write made while a snapshot is open
+	version_store versions;
+
+	//put rows and their balances in place, after they have been logged under
+	//'lsn'. open snapshots get a copy of each row first
+	void apply(const logged_write* writes, int n, uint64_t lsn) {
+		std::shared_lock<std::shared_mutex> shared(versions_lock);
+		if (versions.any())
+		{
+			uint64_t v = ++version;
+			for (int i = 0; i < n; i++)
+			{
+				long slot = (long)writes[i].slot;
+				account_record old;
+				pool.read(&old, RECORD_SIZE, (long long)slot * RECORD_SIZE);
+				versions.keep(slot, v, old, slot < column.size() ? column.get(slot) : FREE_BALANCE);
+			}
+		}
+		for (int i = 0; i < n; i++)
+		{
+			long slot = (long)writes[i].slot;
+			pool.write(&writes[i].image.rec, RECORD_SIZE, (long long)slot * RECORD_SIZE, lsn);
+			column.set(slot, writes[i].image.cents);
+		}
+	}
+
+	//take the most recently freed slot, -1 if there is none
+	long pop_free() {
+		while (free_count > 0)
+		{
+			int32_t s;
+			free_count--;
+			free_list.read_at(&s, sizeof(s), (long long)free_count * sizeof(s));
+			free_list.truncate((long long)free_count * sizeof(s));
+
+			//skip entries a crash left behind for slots that are in use again
+			account_record rec;
+			if (s >= 0 && s < slots && read(s, rec) && is_free(rec))
+				return s;
+		}
+		return -1;
+	}
+
+public:
+	//open the data file, its free list, its log and its balance column. entries
+	//left in the log by a crash are replayed, after which the free list is
+	//rebuilt because it is not logged
+	bool open(const char* data_file, const char* free_file, const char* log_file, const char* balance_file) {
+		data_path = data_file;
+		if (!data.open(data_file) || !free_list.open(free_file) || !log.open(log_file) || !column.open(balance_file))
+			return false;
+		pool.open(data, POOL_PAGES, [this](uint64_t lsn) { log.commit(lsn); });
+		pool.use_async_io(64);
+		reader.open(256);
+
+		recovered = log.replay([this](long slot, const char* image, uint32_t length) {
+			if (slot == MULTI_WRITE)
+			{
+				for (uint32_t at = 0; at + sizeof(logged_write) <= length; at += sizeof(logged_write))
+				{
+					logged_write w;
+					memcpy(&w, image + at, sizeof(w));
+					apply(&w, 1, 0);
+				}
+				return;
+			}
+			//logs written before the balance column held the row alone
+			if (length != (uint32_t)sizeof(logged_record) && length != (uint32_t)RECORD_SIZE) return;
+			logged_write w;
+			w.slot = slot;
+			memcpy(&w.image.rec, image, RECORD_SIZE);
+			w.image.cents = cents_of(w.image.rec);
+			if (length == (uint32_t)sizeof(logged_record)) memcpy(&w.image.cents, image + offsetof(logged_record, cents), sizeof(int64_t));
+			apply(&w, 1, 0);
+			});
+		pool.flush();
+		slots = (long)(data.size() / RECORD_SIZE);
+		free_count = (long)(free_list.size() / sizeof(int32_t));
+		if (recovered > 0)
+		{
+			data.sync();
+			column.sync();
+			log.reset();
+			rebuild_free_list();
+		}
+		view.open(data_file);
+		view.cover(slots);
+		if (column.size() != slots)
+		{
+			rebuild_column();
+			column.sync();
+		}
+		return true;
+	}
+
+	//number of log entries replayed by open(), anything that is derived from
+	//the data file has to be rebuilt when this is not 0
+	long recovered_entries() const { return recovered; }
+
+	//group commit policy of the log, see write_ahead_log::set_group_commit
+	void set_group_commit(long entries, long max_delay_us) {
+		log.set_group_commit(entries, max_delay_us);
+	}
+
+	//wait until the write that returned this lsn is durable
+	void commit(uint64_t lsn) {
+		log.commit(lsn);
+	}
+
+	//size the buffer pool, dropping what it holds. only before the store is used
+	void set_pool_pages(size_t pages) {
+		pool.flush();
+		pool.open(data, pages, [this](uint64_t lsn) { log.commit(lsn); });
+	}
+
+	pool_stats cache_stats() { return pool.stats(); }
+
+	//make every write so far durable, and checkpoint when the log is large
+	void commit() {
+		log.commit_all();
+		if (log.size() >= CHECKPOINT_BYTES) checkpoint();
+	}
+
+	//write back the cached pages, flush the data file and empty the log
+	void checkpoint() {
+		log.commit_all();
+		pool.flush();
+		data.sync();
+		column.sync();
+		log.reset();
+	}
+
+	//slots in the file, free ones included
+	long count() const { return slots; }
+
+	long free_slots() const { return free_count; }
+
+	long live() const { return slots - free_count; }
+
+	//balances of every slot in cents, FREE_BALANCE for deleted ones
+	const balance_column& balances() const { return column; }
+
+	int64_t balance(long slot) const { return column.get(slot); }
+
+	//read the record at a 0 based slot, false if there is no such slot
+	bool read(long slot, account_record& rec) {
+		if (slot < 0 || slot >= slots) return false;
+		pool.read(&rec, RECORD_SIZE, (long long)slot * RECORD_SIZE);
+		return true;
+	}
+
+	//overwrite the record at an existing slot with its exact balance in cents.
+	//the change is logged first and becomes durable with the next group
+	//commit or commit(), returns its lsn
+	uint64_t write(long slot, const account_record& rec, int64_t cents) {
+		logged_write w;
+		memset(&w, 0, sizeof(w));
+		w.slot = slot;
+		w.image.rec = rec;
+		w.image.cents = cents;
+		uint64_t lsn = log.append(slot, &w.image, sizeof(w.image));
+		apply(&w, 1, lsn);
+		return lsn;
+	}
+
+	//same with the balance taken from the float in the record
+	uint64_t write(long slot, const account_record& rec) {
+		return write(slot, rec, cents_of(rec));
+	}
+
+	//overwrite several existing slots under a single log entry, so after a
+	//crash either all of them are replayed or none is. returns its lsn
+	uint64_t write_many(const logged_write* writes, int n) {
+		uint64_t lsn = log.append(MULTI_WRITE, writes, (uint32_t)(n * sizeof(logged_write)));
+		apply(writes, n, lsn);
+		return lsn;
+	}
+
+	//read the records at many slots, out[i] getting the one at batch[i], and
+	//call done(i, ok) for each as it arrives, in no particular order. ok is
+	//false for a slot past the end of the file. records on a page the pool
+	//holds are copied from it straight away, the others are read from the
+	//file with every read in flight at once. such a read is done again
+	//through the pool when the pool has taken its page in or written a page
+	//back since, so it never returns a row older than the cache holds. done
+	//may not call read_batch
+	template <class F>
+	void read_batch(const long* batch, size_t n, account_record* out, F done) {
+		std::vector<io_request> reads;
+		uint64_t file_as_of = pool.write_back_count();
+		for (size_t i = 0; i < n; i++)
+		{
+			long long at = (long long)batch[i] * RECORD_SIZE;
+			if (batch[i] < 0 || batch[i] >= slots) done(i, false);
+			else if (!reader.is_open() || pool.cached(RECORD_SIZE, at))
+			{
+				pool.read(&out[i], RECORD_SIZE, at);
+				done(i, true);
+			}
+			else
+			{
+				io_request r = { false, data.handle(), &out[i], (uint32_t)RECORD_SIZE, at, (uint64_t)i };
+				reads.push_back(r);
+			}
+		}
+		if (reads.empty()) return;
+		std::lock_guard<std::mutex> guard(reader_lock);
+		reader.run(reads.data(), reads.size(), [&](const io_completion& c) {
+			size_t i = (size_t)c.tag;
+			//a short or failed read, or one the cache may be ahead of, is done
+			//again through the pool
+			long long at = (long long)batch[i] * RECORD_SIZE;
+			if (c.result != (long long)RECORD_SIZE || pool.write_back_count() != file_as_of || pool.cached(RECORD_SIZE, at))
+				pool.read(&out[i], RECORD_SIZE, at);
+			done(i, true);
+			});
+	}
+
+	//store a new record in a free slot or at the end of the file, returns the slot
+	long insert(const account_record& rec, int64_t cents) {
+		long slot = pop_free();
+		if (slot < 0) slot = slots++;
+		write(slot, rec, cents);
+		return slot;
+	}
+
+	long insert(const account_record& rec) {
+		return insert(rec, cents_of(rec));
+	}
+
+	//clear a record in place and make its slot reusable
+	void erase(long slot) {
+		account_record empty;
+		memset(&empty, 0, sizeof(empty));
+		write(slot, empty, FREE_BALANCE);
+		push_free(slot);
+	}
+
+	//the whole file as an array of records, empty if it can not be mapped.
+	//valid until the next write to the store
+	const record_view& records() {
+		pool.flush();
+		view.cover(slots);
+		return view;
+	}
+
+	//call visit(slot, record) for every live record in file order
+	template <class F>
+	void scan(F visit) {
+		pool.flush();
+		if (view.cover(slots))
+		{
+			for (long slot = 0; slot < slots; slot++)
+			{
+				if (!is_free(view[slot])) visit(slot, view[slot]);
+			}
+			return;
+		}
+
+		std::vector<account_record> batch(SCAN_BATCH);
+		for (long first = 0; first < slots; first += SCAN_BATCH)
+		{
+			size_t got = data.read_at(batch.data(), (size_t)SCAN_BATCH * RECORD_SIZE, (long long)first * RECORD_SIZE) / RECORD_SIZE;
+			for (size_t i = 0; i < got; i++)
+			{
+				if (!is_free(batch[i])) visit(first + (long)i, batch[i]);
+			}
+		}
+	}
+
+	//append records and their balances in cents at the end of the file with one
+	//write and without logging them, for bulk loads. free slots are not reused.
+	//the records are durable once checkpoint() has run, returns the slot of
+	//the first one
+	long append_unlogged(const account_record* recs, const int64_t* cents, long n) {
+		std::shared_lock<std::shared_mutex> shared(versions_lock);
+		long first = slots;
+		pool.write(recs, (size_t)n * RECORD_SIZE, (long long)first * RECORD_SIZE, 0);
+		column.append(cents, n);
+		slots += n;
+		return first;
+	}
+
+	//start a snapshot: its version, with the slot count and every balance as
+	//they are now. the cached pages are written back so the file holds each
+	//row as it is now or a later version of it
+	uint64_t open_snapshot(long& slot_count, std::vector<int64_t>& cents) {
+		std::unique_lock<std::shared_mutex> alone(versions_lock);
+		versions.open_snapshot(version);
+		slot_count = slots;
+		cents.assign(column.data(), column.data() + std::min<long>(slot_count, column.size()));
+		pool.flush();
+		return version;
+	}
+
+	void close_snapshot(uint64_t at) {
+		versions.close_snapshot(at);
+	}
+
+	//the row a snapshot at version 'at' sees if it was changed after it
+	bool older_version(long slot, uint64_t at, account_record& rec) {
+		return versions.find(slot, at, rec);
+	}
+
+	const std::string& path() const { return data_path; }
+
+	//rows saved for open snapshots
+	long kept_versions() const { return versions.versions(); }
+
+	//true when compacting would give back a worthwhile amount of space
+	bool needs_compaction() const {
+		return free_count >= 1024 && free_count * 2 >= slots && !versions.any();
+	}
+
+	//rewrite the file with only the live records and empty the free list.
+	//the new file is written beside the old one and renamed over it, so a
+	//crash leaves one whole file or the other. returns the number of slots
+	//reclaimed, 0 if the new file could not be written or put in place, or
+	//-1 without doing anything while a snapshot is open since it reads the
+	//file by slot. record
+	//positions change, so every index over the file has to be rebuilt
+	//afterwards
+	long compact() {
+		if (versions.any()) return -1;
+		checkpoint();
+		std::string tmp_path = data_path + ".tmp";
+		long kept = 0;
+		std::vector<int64_t> kept_cents;
+		{
+			block_file tmp;
+			if (!tmp.open(tmp_path.c_str())) return 0;
+			tmp.truncate(0);
+			std::vector<account_record> out;
+			out.reserve(SCAN_BATCH);
+			scan([&](long slot, const account_record& rec) {
+				kept_cents.push_back(column.get(slot));
+				out.push_back(rec);
+				if ((int)out.size() == SCAN_BATCH)
+				{
+					tmp.write_at(out.data(), out.size() * RECORD_SIZE, (long long)kept * RECORD_SIZE);
+					kept += (long)out.size();
+					out.clear();
+				}
+				});
+			if (!out.empty())
+			{
+				tmp.write_at(out.data(), out.size() * RECORD_SIZE, (long long)kept * RECORD_SIZE);
+				kept += (long)out.size();
+			}
+			tmp.sync();
+		}
+
+		long reclaimed = slots - kept;
+		view.close();
+#ifdef _WIN32
+		data.close(); //windows can not replace a file that is open
+#endif
+		if (!replace_file(tmp_path.c_str(), data_path.c_str()))
+		{
+			//the old file is still in place and whole
+			remove(tmp_path.c_str());
+			if (!data.is_open()) data.open(data_path.c_str());
+			view.open(data_path.c_str());
+			view.cover(slots);
+			return 0;
+		}
+		data.close();
+		data.open(data_path.c_str());
+		pool.clear();
+		view.open(data_path.c_str());
+		slots = kept;
+		view.cover(slots);
+		column.reset(kept_cents);
+		column.sync();
+		free_list.truncate(0);
+		free_count = 0;
+		return reclaimed;
+	}
+};
+
+//read only view of a record_store as it was when the snapshot was taken.
+//writers are only held up for the moment it takes to start one. the store
+//keeps the rows the snapshot needs until it is destroyed
+class record_snapshot
+{
+private:
+	record_store& store;
+	uint64_t version;
+	long slots = 0;
+	std::vector<int64_t> cents;
+	record_view view; //a mapping of its own, never remapped under the reader
+	bool mapped;
+
+public:
+	explicit record_snapshot(record_store& s) : store(s) {
+		version = store.open_snapshot(slots, cents);
+		mapped = view.open(store.path().c_str()) && view.cover(slots);
+	}
+
+	~record_snapshot() { store.close_snapshot(version); }
+
+	record_snapshot(const record_snapshot&) = delete;
+	record_snapshot& operator=(const record_snapshot&) = delete;
+
+	//slots in the file when the snapshot was taken
+	long count() const { return slots; }
+
+	//balance of every slot in cents at the snapshot, FREE_BALANCE for free ones
+	const std::vector<int64_t>& balances() const { return cents; }
+
+	//the row of a slot at the snapshot, false if there was no such slot.
+	//the current row is read first and replaced by a saved copy if one turns
+	//up, a write racing with the read always leaves one behind
+	bool read(long slot, account_record& rec) {
+		if (slot < 0 || slot >= slots) return false;
+		if (mapped) rec = view[slot];
+		else store.read(slot, rec);
+		store.older_version(slot, version, rec);
+		return true;
+	}
+
+	//call visit(slot, record, cents) for every live record at the snapshot
+	template <class F>
+	void scan(F visit) {
+		account_record rec;
+		for (long slot = 0; slot < slots; slot++)
+		{
+			if (slot < (long)cents.size() && cents[slot] == FREE_BALANCE) continue;
+			read(slot, rec);
+			if (!is_free(rec)) visit(slot, rec, slot < (long)cents.size() ? cents[slot] : to_cents(rec.total_Balance));
+		}
+	}
+};
+
+#endif //BANK_RECORDSTORE_H
@@ -0,0 +1,154 @@
+//read only memory mapped view of record.bank. the records are exposed as an
+//array of account_record, so scans and lookups are plain memory reads with no
+//system call or copy per record. writes made through record_store show up in
+//the mapping right away because both go through the same page cache.
+//
+//the file grows while it is mapped: cover() remaps it when records past the
+//end of the current mapping are needed. pointers taken from the view are only
+//valid until the next cover()
+
+#ifndef BANK_RECORDVIEW_H
+#define BANK_RECORDVIEW_H
+
+#include "accountRecord.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class record_view
+{
+private:
+	int fd = -1;
+	const char* base = nullptr;
+	size_t length = 0; //bytes mapped, always whole records
+#ifdef _WIN32
+	HANDLE mapping = nullptr;
+#endif
+
+	long long file_size() const {
+#ifdef _WIN32
+		struct _stat64 st;
+		if (_fstat64(fd, &st) != 0) return -1;
+#else
+		struct stat st;
+		if (fstat(fd, &st) != 0) return -1;
+#endif
+		return (long long)st.st_size;
+	}
+
+	void unmap() {
+		if (base == nullptr) return;
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+		CloseHandle(mapping);
+		mapping = nullptr;
+#else
+		munmap((void*)base, length);
+#endif
+		base = nullptr;
+		length = 0;
+	}
+
+	//map the first 'bytes' bytes of the file, replacing the current mapping
+	bool map(size_t bytes) {
+		if (bytes == 0)
+		{
+			unmap();
+			return true;
+		}
+#ifdef _WIN32
+		unmap();
+		mapping = CreateFileMappingA((HANDLE)_get_osfhandle(fd), NULL, PAGE_READONLY,
+			(DWORD)((unsigned long long)bytes >> 32), (DWORD)bytes, NULL);
+		if (mapping == nullptr) return false;
+		base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, bytes);
+		if (base == nullptr)
+		{
+			CloseHandle(mapping);
+			mapping = nullptr;
+			return false;
+		}
+#elif defined(__linux__)
+		void* p = base == nullptr
+			? mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0)
+			: mremap((void*)base, length, bytes, MREMAP_MAYMOVE);
+		if (p == MAP_FAILED)
+		{
+			base = nullptr;
+			length = 0;
+			return false;
+		}
+		base = (const char*)p;
+#else
+		unmap();
+		void* p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) return false;
+		base = (const char*)p;
+#endif
+		length = bytes;
+		return true;
+	}
+
+public:
+	~record_view() { close(); }
+
+	bool open(const char* file_path) {
+		close();
+#ifdef _WIN32
+		fd = _open(file_path, _O_RDONLY | _O_BINARY);
+#else
+		fd = ::open(file_path, O_RDONLY);
+#endif
+		if (fd < 0) return false;
+		return cover(0);
+	}
+
+	void close() {
+		unmap();
+		if (fd < 0) return;
+#ifdef _WIN32
+		_close(fd);
+#else
+		::close(fd);
+#endif
+		fd = -1;
+	}
+
+	bool is_open() const { return fd >= 0; }
+
+	//make sure the first 'records' records are mapped, following the file
+	//as it grows. false if the file is shorter or it can not be mapped
+	bool cover(long records) {
+		if (fd < 0) return false;
+		size_t needed = (size_t)records * RECORD_SIZE;
+		if (needed <= length && base != nullptr) return true;
+
+		long long size = file_size();
+		if (size < 0) return false;
+		size_t whole = (size_t)(size / RECORD_SIZE) * RECORD_SIZE;
+		if (whole < needed) return false;
+		if (whole == length) return true;
+		return map(whole);
+	}
+
+	//records currently mapped
+	long size() const { return (long)(length / RECORD_SIZE); }
+
+	const account_record* begin() const { return (const account_record*)base; }
+	const account_record* end() const { return begin() + size(); }
+	const account_record& operator[](long slot) const { return begin()[slot]; }
+};
+
+#endif //BANK_RECORDVIEW_H
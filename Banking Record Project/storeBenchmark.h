@@ -0,0 +1,246 @@
+//load generator for the record store and its two indexes. it replays a
+//random mix of the menu operations of account_query from worker threads:
+//create an account, show a record by its position, search by account
+//number, edit, delete and a full listing. every operation is timed and the
+//bytes its thread moved through the files are counted, see thread_io() in
+//fileIO.h, so each kind gets its own latency percentiles and I/O cost.
+//
+//the store allows one layout change at a time, so creates and deletes take
+//the benchmark's layout lock alone while the other operations share it.
+//edits of one slot are kept apart by lock stripes as in transactionEngine.h
+
+#ifndef BANK_STOREBENCHMARK_H
+#define BANK_STOREBENCHMARK_H
+
+#include "accountIndex.h"
+#include "nameIndex.h"
+#include "recordStore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+enum bench_op
+{
+	BENCH_CREATE,
+	BENCH_READ,   //show a record by its position
+	BENCH_FIND,   //search by account number
+	BENCH_EDIT,
+	BENCH_DELETE,
+	BENCH_SCAN,   //list every record
+	BENCH_OPS,
+};
+
+inline const char* bench_op_name(int op) {
+	switch (op)
+	{
+	case BENCH_CREATE: return "create";
+	case BENCH_READ: return "read";
+	case BENCH_FIND: return "find";
+	case BENCH_EDIT: return "edit";
+	case BENCH_DELETE: return "delete";
+	case BENCH_SCAN: return "scan";
+	}
+	return "";
+}
+
+struct bench_options
+{
+	int threads = 4;
+	long operations = 20000; //per thread
+	//share of each operation in percent, in bench_op order
+	int mix[BENCH_OPS] = { 5, 40, 40, 10, 4, 1 };
+};
+
+struct bench_op_result
+{
+	long count = 0;
+	long missed = 0; //reads, finds, edits and deletes that hit no live account
+	double p50_us = 0, p99_us = 0, p999_us = 0, max_us = 0;
+	long long bytes_read = 0;
+	long long bytes_written = 0;
+};
+
+struct bench_result
+{
+	long operations = 0;
+	double seconds = 0;
+	bench_op_result ops[BENCH_OPS];
+};
+
+//account number of the n-th account a benchmark creates
+inline void bench_account_number(long n, char* out, size_t size) {
+	snprintf(out, size, "BM%ld", n);
+}
+
+class store_benchmark
+{
+private:
+	static const int STRIPES = 1024;
+
+	struct alignas(64) stripe
+	{
+		std::mutex lock;
+	};
+
+	struct worker_stats
+	{
+		std::vector<int64_t> latency_ns[BENCH_OPS];
+		long missed[BENCH_OPS] = {};
+		io_counters io[BENCH_OPS];
+	};
+
+	record_store& store;
+	account_index& index;
+	name_index& names;
+	std::shared_mutex layout;
+	std::unique_ptr<stripe[]> stripes;
+	std::atomic<long> next_account; //account numbers handed out so far
+
+	//one operation, false when it found no live account to work on
+	bool run_op(int op, std::mt19937_64& rng) {
+		account_record rec;
+		if (op == BENCH_CREATE)
+		{
+			memset(&rec, 0, sizeof(rec));
+			bench_account_number(next_account++, rec.account_number, sizeof(rec.account_number));
+			strcpy(rec.firstName, "New");
+			strcpy(rec.lastName, "Bench");
+			rec.total_Balance = 100.0f;
+			std::unique_lock<std::shared_mutex> alone(layout);
+			long slot = store.insert(rec, 10000);
+			index.insert(rec.account_number, slot);
+			names.insert(rec.lastName, rec.firstName, slot);
+			store.commit();
+			return true;
+		}
+		if (op == BENCH_DELETE)
+		{
+			std::unique_lock<std::shared_mutex> alone(layout);
+			long slot = (long)(rng() % (uint64_t)std::max(store.count(), 1L));
+			if (!store.read(slot, rec) || is_free(rec)) return false;
+			index.erase(rec.account_number);
+			names.erase(rec.lastName, rec.firstName, slot);
+			store.erase(slot);
+			store.commit();
+			return true;
+		}
+
+		std::shared_lock<std::shared_mutex> shared(layout);
+		if (op == BENCH_SCAN)
+		{
+			//the snapshot reads through a memory map the counters can not
+			//see, so the rows it walked are counted as read
+			record_snapshot snapshot(store);
+			long rows = 0;
+			snapshot.scan([&rows](long, const account_record&, int64_t) { rows++; });
+			thread_io().read += (long long)snapshot.count() * RECORD_SIZE;
+			return rows > 0;
+		}
+		long slot;
+		if (op == BENCH_FIND)
+		{
+			char number[INDEX_KEY_SIZE];
+			bench_account_number((long)(rng() % (uint64_t)next_account.load()), number, sizeof(number));
+			if (!index.find(number, slot)) return false;
+		}
+		else slot = (long)(rng() % (uint64_t)std::max(store.count(), 1L));
+		if (op != BENCH_EDIT) return store.read(slot, rec) && !is_free(rec);
+
+		uint64_t lsn;
+		{
+			std::lock_guard<std::mutex> guard(stripes[slot % STRIPES].lock);
+			if (!store.read(slot, rec) || is_free(rec)) return false;
+			int64_t cents = store.balance(slot) + 100;
+			rec.total_Balance = (float)((double)cents / 100.0);
+			lsn = store.write(slot, rec, cents);
+		}
+		//still under the shared lock, so a checkpoint of a create or delete
+		//can not empty the log in the middle of it
+		store.commit(lsn);
+		return true;
+	}
+
+	void work(const bench_options& opt, unsigned seed, worker_stats& out) {
+		std::mt19937_64 rng(seed);
+		std::uniform_int_distribution<int> percent(0, 99);
+		for (int op = 0; op < BENCH_OPS; op++) out.latency_ns[op].reserve(opt.operations * opt.mix[op] / 100 + 16);
+		for (long i = 0; i < opt.operations; i++)
+		{
+			int pick = percent(rng), op = 0;
+			while (op < BENCH_OPS - 1 && pick >= opt.mix[op]) pick -= opt.mix[op++];
+			io_counters before = thread_io();
+			auto began = std::chrono::steady_clock::now();
+			bool hit = run_op(op, rng);
+			out.latency_ns[op].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - began).count());
+			out.io[op].read += thread_io().read - before.read;
+			out.io[op].written += thread_io().written - before.written;
+			if (!hit) out.missed[op]++;
+		}
+	}
+
+	static double percentile_us(const std::vector<int64_t>& sorted, double p) {
+		if (sorted.empty()) return 0;
+		return (double)sorted[(size_t)(p * (double)(sorted.size() - 1))] / 1000.0;
+	}
+
+public:
+	//'accounts' is how many accounts numbered by bench_account_number the
+	//store was filled with
+	store_benchmark(record_store& s, account_index& i, name_index& n, long accounts)
+		: store(s), index(i), names(n), stripes(new stripe[STRIPES]), next_account(accounts) {}
+
+	//false when the mix does not add up to 100
+	bool run(const bench_options& opt, bench_result& result) {
+		int total = 0;
+		for (int op = 0; op < BENCH_OPS; op++)
+		{
+			if (opt.mix[op] < 0) return false;
+			total += opt.mix[op];
+		}
+		if (total != 100 || next_account.load() < 1) return false;
+
+		result = bench_result();
+		std::vector<worker_stats> stats(opt.threads);
+		std::vector<std::thread> workers;
+		auto began = std::chrono::steady_clock::now();
+		for (int t = 0; t < opt.threads; t++)
+			workers.emplace_back(&store_benchmark::work, this, std::cref(opt), 777u + t, std::ref(stats[t]));
+		for (auto& w : workers) w.join();
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+		store.commit();
+
+		for (int op = 0; op < BENCH_OPS; op++)
+		{
+			std::vector<int64_t> all;
+			bench_op_result& r = result.ops[op];
+			for (auto& s : stats)
+			{
+				all.insert(all.end(), s.latency_ns[op].begin(), s.latency_ns[op].end());
+				r.missed += s.missed[op];
+				r.bytes_read += s.io[op].read;
+				r.bytes_written += s.io[op].written;
+			}
+			std::sort(all.begin(), all.end());
+			r.count = (long)all.size();
+			r.p50_us = percentile_us(all, 0.50);
+			r.p99_us = percentile_us(all, 0.99);
+			r.p999_us = percentile_us(all, 0.999);
+			r.max_us = all.empty() ? 0 : (double)all.back() / 1000.0;
+			result.operations += r.count;
+		}
+		return true;
+	}
+};
+
+#endif //BANK_STOREBENCHMARK_H
@@ -0,0 +1,305 @@
+//deposits, withdrawals and transfers on the balances in record_store, safe to
+//run from many threads at once. every account maps to one of a fixed set of
+//lock stripes by its slot; a transfer takes the stripes of both accounts in
+//stripe order, so two transfers can never wait on each other in a cycle.
+//locks are dropped as soon as the change is logged and applied, and the
+//thread then waits for the group commit of its log entry outside of them
+//
+//transaction_load drives the engine from worker threads and measures it,
+//optionally with report threads reading snapshots of the store meanwhile
+
+#ifndef BANK_TRANSACTIONENGINE_H
+#define BANK_TRANSACTIONENGINE_H
+
+#include "accountIndex.h"
+#include "recordStore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+enum txn_status
+{
+	TXN_OK,
+	TXN_NO_ACCOUNT,
+	TXN_SAME_ACCOUNT,
+	TXN_BAD_AMOUNT,
+	TXN_INSUFFICIENT_FUNDS,
+	TXN_BALANCE_LIMIT, //the balance would go past transaction_engine::MAX_BALANCE
+};
+
+inline const char* txn_message(txn_status status) {
+	switch (status)
+	{
+	case TXN_OK: return "Done";
+	case TXN_NO_ACCOUNT: return "Account Number not found!";
+	case TXN_SAME_ACCOUNT: return "Can not transfer to the same account!";
+	case TXN_BAD_AMOUNT: return "Amount must be more than 0!";
+	case TXN_INSUFFICIENT_FUNDS: return "Insufficient balance!";
+	case TXN_BALANCE_LIMIT: return "The balance would go over the largest allowed!";
+	}
+	return "";
+}
+
+class transaction_engine
+{
+private:
+	static const int STRIPES = 1024;
+
+	//one mutex per cache line so threads on neighbouring stripes do not
+	//invalidate each other's lock word
+	struct alignas(64) stripe
+	{
+		std::mutex lock;
+	};
+
+	record_store& store;
+	account_index& index;
+	std::unique_ptr<stripe[]> stripes;
+
+	std::mutex& lock_of(long slot) {
+		return stripes[slot % STRIPES].lock;
+	}
+
+	//the row of a live account with its balance set to 'cents'
+	bool load(long slot, int64_t cents, logged_write& w) {
+		memset(&w, 0, sizeof(w));
+		if (!store.read(slot, w.image.rec) || is_free(w.image.rec)) return false;
+		w.slot = slot;
+		w.image.cents = cents;
+		w.image.rec.total_Balance = (float)((double)cents / 100.0);
+		return true;
+	}
+
+public:
+	//largest amount a single transaction moves, keeps every sum far from overflow
+	static const int64_t MAX_AMOUNT = 1000000000000000LL;
+	//largest balance a deposit or transfer may leave, 10^15 in whole units.
+	//balances loaded in bulk may be larger, and then can only go down
+	static const int64_t MAX_BALANCE = 100000000000000000LL;
+
+	transaction_engine(record_store& s, account_index& i) : store(s), index(i), stripes(new stripe[STRIPES]) {}
+
+	//slot of an account number, -1 if there is no such account
+	long find(const char* account_number) {
+		long slot;
+		return index.find(account_number, slot) ? slot : -1;
+	}
+
+	//add 'cents' to an account, or take them away when negative. the balance
+	//may not go below 0 through a withdrawal or above MAX_BALANCE through a
+	//deposit. both are checked before the sum is taken, so it never overflows
+	txn_status change(long slot, int64_t cents) {
+		if (cents == 0 || cents > MAX_AMOUNT || cents < -MAX_AMOUNT) return TXN_BAD_AMOUNT;
+		logged_write w;
+		uint64_t lsn;
+		{
+			std::lock_guard<std::mutex> guard(lock_of(slot));
+			int64_t balance = store.balance(slot);
+			if (balance == FREE_BALANCE) return TXN_NO_ACCOUNT;
+			if (cents < 0 && balance < -cents) return TXN_INSUFFICIENT_FUNDS;
+			if (cents > 0 && balance > MAX_BALANCE - cents) return TXN_BALANCE_LIMIT;
+			if (!load(slot, balance + cents, w)) return TXN_NO_ACCOUNT;
+			lsn = store.write(slot, w.image.rec, w.image.cents);
+		}
+		store.commit(lsn);
+		return TXN_OK;
+	}
+
+	//move 'cents' between two accounts. both rows go to the log as one entry
+	//so a crash can not keep one half of a transfer
+	txn_status transfer(long from, long to, int64_t cents) {
+		if (cents <= 0 || cents > MAX_AMOUNT) return TXN_BAD_AMOUNT;
+		if (from == to) return TXN_SAME_ACCOUNT;
+		std::mutex& first = lock_of(std::min(from % STRIPES, to % STRIPES));
+		std::mutex& second = lock_of(std::max(from % STRIPES, to % STRIPES));
+		logged_write w[2];
+		uint64_t lsn;
+		{
+			std::unique_lock<std::mutex> a(first);
+			std::unique_lock<std::mutex> b;
+			if (&second != &first) b = std::unique_lock<std::mutex>(second);
+
+			int64_t from_balance = store.balance(from);
+			int64_t to_balance = store.balance(to);
+			if (from_balance == FREE_BALANCE || to_balance == FREE_BALANCE) return TXN_NO_ACCOUNT;
+			if (from_balance < cents) return TXN_INSUFFICIENT_FUNDS;
+			if (to_balance > MAX_BALANCE - cents) return TXN_BALANCE_LIMIT;
+			if (!load(from, from_balance - cents, w[0]) || !load(to, to_balance + cents, w[1])) return TXN_NO_ACCOUNT;
+			lsn = store.write_many(w, 2);
+		}
+		store.commit(lsn);
+		return TXN_OK;
+	}
+
+	txn_status deposit(const char* account_number, int64_t cents) {
+		long slot = find(account_number);
+		if (slot < 0) return TXN_NO_ACCOUNT;
+		return cents <= 0 ? TXN_BAD_AMOUNT : change(slot, cents);
+	}
+
+	txn_status withdraw(const char* account_number, int64_t cents) {
+		long slot = find(account_number);
+		if (slot < 0) return TXN_NO_ACCOUNT;
+		return cents <= 0 ? TXN_BAD_AMOUNT : change(slot, -cents);
+	}
+
+	txn_status transfer(const char* from_account, const char* to_account, int64_t cents) {
+		long from = find(from_account);
+		long to = find(to_account);
+		if (from < 0 || to < 0) return TXN_NO_ACCOUNT;
+		return transfer(from, to, cents);
+	}
+};
+
+struct load_options
+{
+	int threads = 4;
+	long transactions = 100000; //per thread
+	int transfer_percent = 50;  //the rest is split between deposits and withdrawals
+	int64_t max_amount = 10000; //cents per transaction, picked uniformly from 1
+	int readers = 0;            //threads scanning snapshots while the load runs
+};
+
+struct load_result
+{
+	long transactions = 0;
+	long refused = 0; //withdrawals and transfers turned down for lack of funds
+	double seconds = 0;
+	double p50_us = 0, p99_us = 0, p999_us = 0, max_us = 0;
+	int64_t total_before = 0; //sum of the balances before and after the run,
+	int64_t total_after = 0;  //which must differ by exactly the net deposits
+	int64_t net_deposits = 0;
+	long snapshots = 0;       //snapshot scans completed by the readers
+	long torn_rows = 0;       //snapshot rows that disagreed with the snapshot's balance
+	long unbalanced_scans = 0; //transfer only runs: scans whose total was not the starting total
+};
+
+//runs a random mix of transactions on every live account of a store
+class transaction_load
+{
+private:
+	record_store& store;
+	transaction_engine& engine;
+
+	struct worker_stats
+	{
+		std::vector<int64_t> latency_ns;
+		long refused = 0;
+		int64_t net = 0;
+	};
+
+	//scan snapshots until told to stop. every row must carry the balance the
+	//snapshot has for it, and with transfers only the total may never change
+	void report(const load_options& opt, int64_t total, std::atomic<bool>& stop, load_result& out, std::mutex& merge) {
+		long scans = 0, torn = 0, unbalanced = 0;
+		while (!stop.load())
+		{
+			record_snapshot snapshot(store);
+			int64_t sum = 0;
+			snapshot.scan([&](long, const account_record& rec, int64_t cents) {
+				sum += cents;
+				if (to_cents(rec.total_Balance) != cents) torn++;
+				});
+			if (opt.transfer_percent == 100 && sum != total) unbalanced++;
+			scans++;
+		}
+		std::lock_guard<std::mutex> guard(merge);
+		out.snapshots += scans;
+		out.torn_rows += torn;
+		out.unbalanced_scans += unbalanced;
+	}
+
+	void work(const std::vector<long>& slots, const load_options& opt, unsigned seed, worker_stats& out) {
+		std::mt19937_64 rng(seed);
+		std::uniform_int_distribution<size_t> pick(0, slots.size() - 1);
+		std::uniform_int_distribution<int64_t> amount(1, opt.max_amount);
+		std::uniform_int_distribution<int> percent(0, 99);
+		out.latency_ns.reserve(opt.transactions);
+		for (long i = 0; i < opt.transactions; i++)
+		{
+			long a = slots[pick(rng)];
+			int64_t cents = amount(rng);
+			int kind = percent(rng);
+			auto began = std::chrono::steady_clock::now();
+			txn_status status;
+			if (kind < opt.transfer_percent)
+			{
+				long b = slots[pick(rng)];
+				if (a == b) b = slots[(pick(rng) + 1) % slots.size()];
+				status = a == b ? TXN_OK : engine.transfer(a, b, cents);
+			}
+			else if ((kind - opt.transfer_percent) % 2 == 0)
+			{
+				status = engine.change(a, cents);
+				if (status == TXN_OK) out.net += cents;
+			}
+			else
+			{
+				status = engine.change(a, -cents);
+				if (status == TXN_OK) out.net -= cents;
+			}
+			out.latency_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - began).count());
+			if (status == TXN_INSUFFICIENT_FUNDS) out.refused++;
+		}
+	}
+
+	static double percentile_us(std::vector<int64_t>& sorted, double p) {
+		if (sorted.empty()) return 0;
+		size_t at = (size_t)(p * (double)(sorted.size() - 1));
+		return (double)sorted[at] / 1000.0;
+	}
+
+public:
+	transaction_load(record_store& s, transaction_engine& e) : store(s), engine(e) {}
+
+	//false when the store has fewer than two accounts to move money between
+	bool run(const load_options& opt, load_result& result) {
+		std::vector<long> slots;
+		store.scan([&slots](long slot, const account_record&) { slots.push_back(slot); });
+		if (slots.size() < 2) return false;
+
+		result = load_result();
+		result.total_before = store.balances().summarize().total;
+		std::vector<worker_stats> stats(opt.threads);
+		std::vector<std::thread> workers, readers;
+		std::atomic<bool> stop{ false };
+		std::mutex merge;
+		auto began = std::chrono::steady_clock::now();
+		for (int t = 0; t < opt.threads; t++)
+			workers.emplace_back(&transaction_load::work, this, std::cref(slots), std::cref(opt), 12345u + t, std::ref(stats[t]));
+		for (int t = 0; t < opt.readers; t++)
+			readers.emplace_back(&transaction_load::report, this, std::cref(opt), result.total_before, std::ref(stop), std::ref(result), std::ref(merge));
+		for (auto& w : workers) w.join();
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+		stop = true;
+		for (auto& r : readers) r.join();
+		store.commit();
+
+		std::vector<int64_t> all;
+		for (auto& s : stats)
+		{
+			all.insert(all.end(), s.latency_ns.begin(), s.latency_ns.end());
+			result.refused += s.refused;
+			result.net_deposits += s.net;
+		}
+		std::sort(all.begin(), all.end());
+		result.transactions = (long)all.size();
+		result.p50_us = percentile_us(all, 0.50);
+		result.p99_us = percentile_us(all, 0.99);
+		result.p999_us = percentile_us(all, 0.999);
+		result.max_us = all.empty() ? 0 : (double)all.back() / 1000.0;
+		result.total_after = store.balances().summarize().total;
+		return true;
+	}
+};
+
+#endif //BANK_TRANSACTIONENGINE_H
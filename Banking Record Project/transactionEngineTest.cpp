@@ -0,0 +1,103 @@
+//checks the limits transaction_engine puts on a balance. on a scratch store
+//of three accounts it deposits, withdraws and transfers up to and past
+//MAX_BALANCE and 0, and checks every status and every balance after it: a
+//refused change has to leave both balances as they were. the scratch files
+//are removed afterwards. prints the first mismatch and exits with 1, or
+//prints "ok"
+//
+//usage: transactionEngineTest
+
+#include "accountIndex.h"
+#include "recordStore.h"
+#include "transactionEngine.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static int failures = 0;
+
+static void expect(const char* what, txn_status got, txn_status status) {
+	if (got == status) return;
+	if (failures++ == 0) printf("%s: \"%s\", expected \"%s\"\n", what, txn_message(got), txn_message(status));
+}
+
+static void expect_balance(const char* what, record_store& store, long slot, int64_t cents) {
+	int64_t got = store.balance(slot);
+	if (got == cents) return;
+	if (failures++ == 0) printf("%s: balance %lld, expected %lld\n", what, (long long)got, (long long)cents);
+}
+
+int main() {
+	const char* files[] = { "txntest.bank", "txntest.free", "txntest.wal", "txntest.bal", "txntest.idx" };
+	const int64_t MAX = transaction_engine::MAX_BALANCE;
+	const int64_t AMOUNT = transaction_engine::MAX_AMOUNT;
+
+	for (const char* f : files) remove(f);
+	{
+		record_store store;
+		account_index index;
+		if (!store.open(files[0], files[1], files[2], files[3]) || !index.open(files[4]))
+		{
+			printf("can not open the scratch store\n");
+			return 1;
+		}
+
+		//an empty account, one just under the limit and one loaded above it
+		const long accounts = 3;
+		const int64_t start[accounts] = { 0, MAX - 100, MAX + 100 };
+		std::vector<account_record> recs(accounts);
+		std::vector<int64_t> cents(start, start + accounts);
+		std::vector<index_entry> entries(accounts);
+		for (long i = 0; i < accounts; i++)
+		{
+			memset(&recs[i], 0, sizeof(recs[i]));
+			snprintf(recs[i].account_number, sizeof(recs[i].account_number), "TT%d", (int)i);
+			memset(&entries[i], 0, sizeof(entries[i]));
+			memcpy(entries[i].account_number, recs[i].account_number, INDEX_KEY_SIZE);
+			entries[i].record = (int32_t)i;
+		}
+		store.append_unlogged(recs.data(), cents.data(), accounts);
+		store.checkpoint();
+		index.rebuild(entries, accounts);
+		transaction_engine engine(store, index);
+
+		expect("deposit up to the limit", engine.change(1, 100), TXN_OK);
+		expect_balance("deposit up to the limit", store, 1, MAX);
+		expect("deposit past the limit", engine.change(1, 1), TXN_BALANCE_LIMIT);
+		expect_balance("deposit past the limit", store, 1, MAX);
+		expect("largest deposit past the limit", engine.change(1, AMOUNT), TXN_BALANCE_LIMIT);
+		expect("deposit above the limit", engine.change(2, 1), TXN_BALANCE_LIMIT);
+		expect_balance("deposit above the limit", store, 2, MAX + 100);
+		expect("withdrawal above the limit", engine.change(2, -100), TXN_OK);
+		expect_balance("withdrawal above the limit", store, 2, MAX);
+
+		expect("deposit over the largest amount", engine.change(0, AMOUNT + 1), TXN_BAD_AMOUNT);
+		expect("largest deposit", engine.change(0, AMOUNT), TXN_OK);
+		expect("largest withdrawal", engine.change(0, -AMOUNT), TXN_OK);
+		expect_balance("largest withdrawal", store, 0, 0);
+		expect("withdrawal below 0", engine.change(0, -1), TXN_INSUFFICIENT_FUNDS);
+		expect_balance("withdrawal below 0", store, 0, 0);
+
+		expect("deposit", engine.deposit("TT0", 500), TXN_OK);
+		expect("transfer into a full account", engine.transfer(0, 1, 1), TXN_BALANCE_LIMIT);
+		expect_balance("transfer into a full account", store, 0, 500);
+		expect_balance("transfer into a full account", store, 1, MAX);
+		expect("transfer out of a full account", engine.transfer("TT1", "TT0", 400), TXN_OK);
+		expect("transfer up to the limit", engine.transfer(0, 1, 400), TXN_OK);
+		expect_balance("transfer up to the limit", store, 0, 500);
+		expect_balance("transfer up to the limit", store, 1, MAX);
+		expect("transfer over the balance", engine.transfer(0, 2, 501), TXN_INSUFFICIENT_FUNDS);
+		store.checkpoint();
+	}
+	for (const char* f : files) remove(f);
+
+	if (failures > 0)
+	{
+		printf("%d mismatch(es)\n", failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,105 @@
+//older versions of records, kept for the snapshots that are still reading
+//them. every write that happens while a snapshot is open saves the record as
+//it was just before, tagged with the version number of the write. a snapshot
+//taken at version S reads a record from the first saved copy with a version
+//above S, or from the file when there is none. copies are dropped once no
+//open snapshot is older than their write, and nothing is saved at all while
+//no snapshot is open
+
+#ifndef BANK_VERSIONSTORE_H
+#define BANK_VERSIONSTORE_H
+
+#include "accountRecord.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+struct row_version
+{
+	uint64_t version; //version of the write that replaced this copy
+	account_record rec;
+	int64_t cents;
+};
+
+class version_store
+{
+private:
+	std::mutex lock;
+	std::multiset<uint64_t> open; //versions of the open snapshots
+	std::unordered_map<long, std::vector<row_version>> older; //per slot, oldest first
+	std::atomic<long> kept{ 0 };  //copies held, lets readers skip the lock when 0
+	std::atomic<long> open_count{ 0 };
+
+public:
+	//true while any snapshot is open
+	bool any() const { return open_count.load() > 0; }
+
+	long snapshots() const { return open_count.load(); }
+
+	long versions() const { return kept.load(); }
+
+	void open_snapshot(uint64_t version) {
+		std::lock_guard<std::mutex> guard(lock);
+		open.insert(version);
+		open_count++;
+	}
+
+	//forget a snapshot and every copy only it could still read
+	void close_snapshot(uint64_t version) {
+		std::lock_guard<std::mutex> guard(lock);
+		open.erase(open.find(version));
+		open_count--;
+		if (open.empty())
+		{
+			older.clear();
+			kept = 0;
+			return;
+		}
+		uint64_t oldest = *open.begin();
+		for (auto it = older.begin(); it != older.end(); )
+		{
+			std::vector<row_version>& v = it->second;
+			size_t drop = 0;
+			while (drop < v.size() && v[drop].version <= oldest) drop++;
+			v.erase(v.begin(), v.begin() + drop);
+			kept -= (long)drop;
+			if (v.empty()) it = older.erase(it);
+			else ++it;
+		}
+	}
+
+	//save the copy of a slot that a write at 'version' is about to replace
+	void keep(long slot, uint64_t version, const account_record& rec, int64_t cents) {
+		std::lock_guard<std::mutex> guard(lock);
+		row_version v;
+		v.version = version;
+		v.rec = rec;
+		v.cents = cents;
+		older[slot].push_back(v);
+		kept++;
+	}
+
+	//the slot as a snapshot at 'version' sees it, false when the current
+	//copy is the right one
+	bool find(long slot, uint64_t version, account_record& rec) {
+		if (kept.load() == 0) return false;
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = older.find(slot);
+		if (it == older.end()) return false;
+		for (const row_version& v : it->second)
+		{
+			if (v.version > version)
+			{
+				rec = v.rec;
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+#endif //BANK_VERSIONSTORE_H
@@ -0,0 +1,228 @@
+//redo log for record.bank. every record write is appended to record.wal as a
+//full record image before the data file is touched. appends are buffered in
+//memory and made durable in groups: a committing thread becomes the leader,
+//writes everything buffered so far with one write and one fsync, and wakes
+//every other thread whose entries went out with it. after a crash the entries
+//found in the log are replayed onto the data file
+
+#ifndef BANK_WRITEAHEADLOG_H
+#define BANK_WRITEAHEADLOG_H
+
+#include "fileIO.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+const uint32_t WAL_MAGIC = 0x57414C31; //"WAL1"
+
+struct wal_entry_header
+{
+	uint32_t magic;
+	uint32_t checksum; //crc32 of the header with checksum 0, then the payload
+	uint64_t lsn;
+	int64_t slot;
+	uint32_t length; //payload bytes following the header
+	uint32_t unused;
+};
+
+struct crc32_table
+{
+	uint32_t v[256];
+	crc32_table() {
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			v[i] = c;
+		}
+	}
+};
+
+//crc32 of n bytes, continuing from the crc of the bytes before them
+inline uint32_t crc32(const void* data, size_t n, uint32_t crc = 0) {
+	static const crc32_table table;
+	crc = ~crc;
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < n; i++) crc = table.v[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+class write_ahead_log
+{
+private:
+	block_file file;
+	long long end = 0; //file offset of the next flushed entry
+
+	std::mutex lock;
+	std::condition_variable flushed;
+	std::vector<char> pending; //entries appended but not written yet
+	long pending_count = 0;
+	uint64_t next_lsn = 1;
+	uint64_t durable_lsn = 0; //every entry up to this lsn is on disk
+	bool flushing = false;
+	std::chrono::steady_clock::time_point oldest_pending;
+
+	//group commit policy: flush once this many entries are buffered or the
+	//oldest buffered entry is this old, whichever comes first
+	long group_size = 64;
+	std::chrono::microseconds max_delay = std::chrono::microseconds(2000);
+
+	//write and fsync the buffered entries. called with 'lock' held, releases it
+	//for the I/O so other threads can keep appending to the next group. a
+	//group that fails goes back in front of the buffer and the end of the
+	//log back to where it was, so the next flush writes it again in place
+	void flush(std::unique_lock<std::mutex>& held) {
+		while (flushing) flushed.wait(held);
+		if (pending.empty()) return;
+
+		std::vector<char> group;
+		group.swap(pending);
+		uint64_t group_lsn = next_lsn - 1;
+		long group_count = pending_count;
+		auto group_oldest = oldest_pending;
+		pending_count = 0;
+		flushing = true;
+		long long at = end;
+		end += (long long)group.size();
+
+		held.unlock();
+		try
+		{
+			file.write_at(group.data(), group.size(), at);
+			file.sync();
+		}
+		catch (...)
+		{
+			held.lock();
+			group.insert(group.end(), pending.begin(), pending.end());
+			pending.swap(group);
+			pending_count += group_count;
+			oldest_pending = group_oldest;
+			end = at;
+			flushing = false;
+			flushed.notify_all();
+			throw;
+		}
+		held.lock();
+
+		durable_lsn = group_lsn;
+		flushing = false;
+		flushed.notify_all();
+	}
+
+public:
+	//open the log and lock it, so only one process at a time can write the
+	//files it protects. false if it can not be opened or is locked
+	bool open(const char* path) {
+		if (!file.open(path) || !file.try_lock()) return false;
+		end = file.size();
+		return true;
+	}
+
+	void set_group_commit(long entries, long max_delay_us) {
+		std::lock_guard<std::mutex> guard(lock);
+		group_size = entries < 1 ? 1 : entries;
+		max_delay = std::chrono::microseconds(max_delay_us);
+	}
+
+	//buffer one entry and return its lsn. the entry is durable once commit(lsn)
+	//returns; a full or old enough group is flushed right away
+	uint64_t append(long slot, const void* image, uint32_t length) {
+		std::unique_lock<std::mutex> held(lock);
+		wal_entry_header h;
+		memset(&h, 0, sizeof(h));
+		h.magic = WAL_MAGIC;
+		h.lsn = next_lsn++;
+		h.slot = slot;
+		h.length = length;
+		h.checksum = crc32(image, length, crc32(&h, sizeof(h)));
+
+		if (pending.empty()) oldest_pending = std::chrono::steady_clock::now();
+		pending.insert(pending.end(), (const char*)&h, (const char*)&h + sizeof(h));
+		pending.insert(pending.end(), (const char*)image, (const char*)image + length);
+		pending_count++;
+
+		if (pending_count >= group_size || std::chrono::steady_clock::now() - oldest_pending >= max_delay)
+			flush(held);
+		return h.lsn;
+	}
+
+	//wait until the entry with this lsn is on disk, flushing if nobody else is
+	void commit(uint64_t lsn) {
+		std::unique_lock<std::mutex> held(lock);
+		while (durable_lsn < lsn)
+		{
+			if (flushing) flushed.wait(held);
+			else flush(held);
+		}
+	}
+
+	//make every appended entry durable
+	void commit_all() {
+		uint64_t lsn;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			lsn = next_lsn - 1;
+		}
+		commit(lsn);
+	}
+
+	long long size() {
+		std::lock_guard<std::mutex> guard(lock);
+		return end + (long long)pending.size();
+	}
+
+	//drop the whole log once the data file holds every change in it. no
+	//writer may append while this runs
+	void reset() {
+		std::unique_lock<std::mutex> held(lock);
+		flush(held);
+		file.truncate(0);
+		end = 0;
+	}
+
+	//call apply(slot, image, length) for every intact entry in log order and
+	//return how many were replayed. reading stops at the first torn or
+	//corrupt entry, which can only be the tail of an unfinished group; the
+	//log is cut back to the end of the last good entry, so new entries
+	//follow it and are not lost behind the garbage on the next replay
+	template <class F>
+	long replay(F apply) {
+		long count = 0;
+		long long at = 0;
+		long long total = file.size();
+		std::vector<char> payload;
+		while (at + (long long)sizeof(wal_entry_header) <= total)
+		{
+			wal_entry_header h;
+			file.read_at(&h, sizeof(h), at);
+			if (h.magic != WAL_MAGIC || at + (long long)sizeof(h) + h.length > total) break;
+			payload.resize(h.length);
+			file.read_at(payload.data(), h.length, at + sizeof(h));
+
+			uint32_t stored = h.checksum;
+			h.checksum = 0;
+			if (crc32(payload.data(), h.length, crc32(&h, sizeof(h))) != stored) break;
+
+			apply((long)h.slot, payload.data(), h.length);
+			if (h.lsn >= next_lsn) next_lsn = h.lsn + 1;
+			at += sizeof(h) + h.length;
+			count++;
+		}
+		if (at < total)
+		{
+			file.truncate(at);
+			file.sync();
+		}
+		end = at;
+		//what was read back is on disk already
+		durable_lsn = next_lsn - 1;
+		return count;
+	}
+};
+
+#endif //BANK_WRITEAHEADLOG_H
@@ -0,0 +1,413 @@
+//seat bookings from many threads at once. claiming seats is a single compare
+//and swap on the seat word of the bus, so two bookings can never both get a
+//seat. a booking of several seats on one bus claims them all in that one
+//swap; a booking that spans buses claims bus by bus and gives back what it
+//got as soon as one bus fails, so it ends up with all of its seats or none
+//of them. on a bus that stops on the way a booking covers the segments from
+//one stop to another, and claims them under the lock of that bus instead,
+//see segmentMap.h.
+//
+//every booking and cancellation also holds the gate of its bus, one of 64
+//shared_mutexes picked by bus % 64, shared while it claims and logs, so
+//checkpoint() can take every gate to see the fleet and the journal agree.
+//bookings never wait on each other there, but each one adds to and takes
+//from the reader count of the gate: on a hot bus that count is written by
+//every thread as often as the seat word, so its cache line moves between
+//cores with every booking, and buses 64 apart share it. while a checkpoint
+//copies the fleet every booking waits for it, and the checkpoint waits for
+//any booking that is writing a journal batch out under its gate
+//
+//installing buses and looking them up by number or route go through a shared lock,
+//taken alone by install(), as the bus number index and the trip details are
+//not safe to change under readers
+//
+//after open() every install, booking and cancellation is written to a
+//journal, see reservationJournal.h, and the fleet is written to a snapshot
+//every so many entries, see fleetSnapshot.h. a change goes to the journal
+//before anyone else can act on it: a booking after its seats are claimed
+//but before its names are stored, so no cancel of it can be logged first,
+//and a cancel before its seats are freed, so no new booking of them can be
+//logged first. replaying the journal in order thus gives the same seats
+
+#ifndef BUS_BOOKINGENGINE_H
+#define BUS_BOOKINGENGINE_H
+
+#include "fleetSnapshot.h"
+#include "fleetStore.h"
+#include "reservationJournal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+enum book_status
+{
+	BOOK_OK,
+	BOOK_NO_BUS,
+	BOOK_NO_SEAT,
+	BOOK_TAKEN,
+	BOOK_NOT_RESERVED,
+	BOOK_NOT_SAVED, //the journal can no longer be written, nothing was changed
+};
+
+inline const char* book_message(book_status status) {
+	switch (status)
+	{
+	case BOOK_OK: return "Done";
+	case BOOK_NO_BUS: return "Enter correct bus no.";
+	case BOOK_NO_SEAT: return "There is no such seat in this bus.";
+	case BOOK_TAKEN: return "The seat no. is already reserved.";
+	case BOOK_NOT_RESERVED: return "The seat no. is not reserved.";
+	case BOOK_NOT_SAVED: return "The change could not be saved.";
+	}
+	return "";
+}
+
+//seats wanted on one bus, bit i for seat i + 1
+struct seat_request
+{
+	int bus;
+	uint32_t seats;
+	int from = 0; //stops where the passenger boards and leaves, -1 for the
+	int to = -1;  //end of the route
+};
+
+//kinds of journal entries
+enum journal_entry
+{
+	JOURNAL_INSTALL = 1, //trip_info, number of stops on the way, their names
+	JOURNAL_BOOK,        //passenger name, then a journal_leg per bus
+	JOURNAL_CANCEL,      //a journal_cancel
+};
+
+struct journal_leg
+{
+	int32_t bus;
+	uint32_t seats;
+	int8_t from;
+	int8_t to;
+};
+
+struct journal_cancel
+{
+	int32_t bus;
+	int8_t seat;
+	int8_t from;
+};
+
+class booking_engine
+{
+private:
+	static const int GATES = 64;
+
+	struct alignas(64) gate
+	{
+		std::shared_mutex lock;
+	};
+
+	fleet_store& fleet;
+	std::shared_mutex layout;
+	std::unique_ptr<gate[]> gates;
+	reservation_journal journal;
+	std::string snapshot;
+	std::mutex checkpointing;
+	//journal size at the last checkpoint that failed. the next one is only
+	//due a full snapshot_entries later, or every change would take every
+	//gate while the disk stays full
+	std::atomic<long> failed_at{ 0 };
+
+	std::shared_mutex& gate_of(int bus) { return gates[bus % GATES].lock; }
+
+	bool exists(int bus) const { return bus >= 0 && bus < fleet.size(); }
+
+	//a part of the route of an existing bus that goes forward
+	bool valid_leg(int bus, int from, int& to) const {
+		int stops = fleet.stops(bus);
+		if (to < 0) to = stops - 1;
+		return from >= 0 && from < to && to < stops;
+	}
+
+	void name_seats(int bus, uint32_t seats, const char* name, int from, int to) {
+		for (; seats != 0; seats &= seats - 1) fleet.set_passenger(bus, ctz32(seats) + 1, name, from, to);
+	}
+
+	//the log_ calls are false when the journal refuses the entry, see
+	//reservation_journal::append, and the change has to be taken back
+	bool log_install(const trip_info& trip, const std::vector<std::string>& on_the_way) {
+		if (!journal.is_open()) return true;
+		std::vector<char> entry((const char*)&trip, (const char*)&trip + sizeof(trip));
+		entry.push_back((char)on_the_way.size());
+		for (const std::string& stop : on_the_way)
+		{
+			char name[NAME_SIZE] = {};
+			memcpy(name, stop.c_str(), std::min(stop.size(), (size_t)NAME_SIZE - 1));
+			entry.insert(entry.end(), name, name + NAME_SIZE);
+		}
+		return journal.append(JOURNAL_INSTALL, entry.data(), entry.size()) != 0;
+	}
+
+	bool log_book(const char* name, const journal_leg* legs, int n) {
+		if (!journal.is_open()) return true;
+		std::vector<char> entry(NAME_SIZE + n * sizeof(journal_leg));
+		memcpy(entry.data(), name, strnlen(name, NAME_SIZE - 1));
+		memcpy(&entry[NAME_SIZE], legs, n * sizeof(journal_leg));
+		return journal.append(JOURNAL_BOOK, entry.data(), entry.size()) != 0;
+	}
+
+	bool log_book(const char* name, int bus, uint32_t seats, int from, int to) {
+		journal_leg leg = { bus, seats, (int8_t)from, (int8_t)to };
+		return log_book(name, &leg, 1);
+	}
+
+	bool log_cancel(int bus, int seat, int from) {
+		if (!journal.is_open()) return true;
+		journal_cancel entry = { bus, (int8_t)seat, (int8_t)from };
+		return journal.append(JOURNAL_CANCEL, &entry, sizeof(entry)) != 0;
+	}
+
+	//apply a journal entry to the fleet while it is loaded
+	void replay(int type, const char* data, size_t size) {
+		if (type == JOURNAL_INSTALL && size >= sizeof(trip_info) + 1)
+		{
+			trip_info trip;
+			memcpy(&trip, data, sizeof(trip));
+			size_t n = (unsigned char)data[sizeof(trip)];
+			if (size != sizeof(trip) + 1 + n * NAME_SIZE) return;
+			std::vector<std::string> on_the_way;
+			for (size_t i = 0; i < n; i++)
+			{
+				const char* stop = data + sizeof(trip) + 1 + i * NAME_SIZE;
+				on_the_way.push_back(std::string(stop, strnlen(stop, NAME_SIZE)));
+			}
+			fleet.add(trip, on_the_way);
+		}
+		else if (type == JOURNAL_BOOK && size >= NAME_SIZE && (size - NAME_SIZE) % sizeof(journal_leg) == 0)
+		{
+			char name[NAME_SIZE];
+			memcpy(name, data, NAME_SIZE);
+			name[NAME_SIZE - 1] = '\0';
+			for (size_t at = NAME_SIZE; at < size; at += sizeof(journal_leg))
+			{
+				journal_leg leg;
+				memcpy(&leg, data + at, sizeof(leg));
+				int to = leg.to;
+				if (!exists(leg.bus) || !valid_leg(leg.bus, leg.from, to)) continue;
+				fleet.mark(leg.bus, leg.seats, leg.from, to);
+				name_seats(leg.bus, leg.seats, name, leg.from, to);
+			}
+		}
+		else if (type == JOURNAL_CANCEL && size == sizeof(journal_cancel))
+		{
+			journal_cancel entry;
+			memcpy(&entry, data, sizeof(entry));
+			if (exists(entry.bus)) fleet.cancel(entry.bus, entry.seat, entry.from);
+		}
+	}
+
+	//write a snapshot and cut the journal down to what came after it, with
+	//'checkpointing' held
+	bool write_checkpoint() {
+		std::vector<char> image;
+		uint64_t seq;
+		{
+			std::unique_lock<std::shared_mutex> alone(layout);
+			for (int i = 0; i < GATES; i++) gates[i].lock.lock();
+			seq = journal.last_seq();
+			image = take_snapshot(fleet, seq);
+			for (int i = GATES; i-- > 0;) gates[i].lock.unlock();
+		}
+		bool ok = save_snapshot(snapshot.c_str(), image) && journal.compact(seq);
+		failed_at.store(ok ? 0 : journal.size(), std::memory_order_relaxed);
+		return ok;
+	}
+
+	//take a snapshot when the journal has grown long enough, unless one is
+	//being taken already. called with no gate held
+	void checkpoint_if_due() {
+		if (!journal.is_open() || !journal.snapshot_due(failed_at.load(std::memory_order_relaxed))) return;
+		std::unique_lock<std::mutex> one(checkpointing, std::try_to_lock);
+		//the one that held it may just have taken the snapshot
+		if (one.owns_lock() && journal.snapshot_due(failed_at.load(std::memory_order_relaxed))) write_checkpoint();
+	}
+
+public:
+	explicit booking_engine(fleet_store& f) : fleet(f), gates(new gate[GATES]) {}
+
+	~booking_engine() { close(); }
+
+	//load the fleet from the snapshot at 'snapshot_path' and the journal at
+	//'journal_path', either of which may not be there yet, and keep every
+	//change from now on in them. the fleet must be empty. false if a file
+	//can not be opened or the snapshot is damaged
+	bool open(const char* snapshot_path, const char* journal_path, const journal_options& options = journal_options()) {
+		std::unique_lock<std::shared_mutex> alone(layout);
+		uint64_t seq;
+		if (fleet.size() != 0 || !load_snapshot(snapshot_path, fleet, seq)) return false;
+		snapshot = snapshot_path;
+		return journal.open(journal_path, seq, [&](uint64_t, int type, const char* data, size_t size) { replay(type, data, size); }, options);
+	}
+
+	//wait until every change so far is on the disk, false if the journal
+	//is not open or could not be written
+	bool sync() { return journal.is_open() && journal.sync(); }
+
+	//write a snapshot of the fleet now and drop the journal entries it holds
+	bool checkpoint() {
+		if (!journal.is_open()) return false;
+		std::lock_guard<std::mutex> one(checkpointing);
+		return write_checkpoint();
+	}
+
+	//write out the journal and stop keeping changes
+	void close() { journal.close(); }
+
+	//add a bus, -1 when its number is installed already and -2 when the
+	//journal can no longer be written. 'on_the_way' are the stops between
+	//trip.from and trip.to
+	int install(const trip_info& trip, const std::vector<std::string>& on_the_way = std::vector<std::string>()) {
+		int bus;
+		{
+			std::unique_lock<std::shared_mutex> alone(layout);
+			//a bus can not be taken out again, so the journal is asked first
+			if (journal.is_open() && !journal.good()) return -2;
+			bus = fleet.add(trip, on_the_way);
+			if (bus >= 0) log_install(trip, on_the_way);
+		}
+		checkpoint_if_due();
+		return bus;
+	}
+
+	//position of a bus, -1 if there is none with this number
+	int find(const char* number) {
+		std::shared_lock<std::shared_mutex> shared(layout);
+		return fleet.find(number);
+	}
+
+	//position of a stop of a bus, -1 if it does not stop there
+	int find_stop(int bus, const char* place) {
+		std::shared_lock<std::shared_mutex> shared(layout);
+		return exists(bus) ? fleet.find_stop(bus, place) : -1;
+	}
+
+	//copy of the trip details of a bus, false if there is no such bus
+	bool trip(int bus, trip_info& out) {
+		std::shared_lock<std::shared_mutex> shared(layout);
+		if (!exists(bus)) return false;
+		out = fleet.trip(bus);
+		return true;
+	}
+
+	//see fleet_store::search
+	std::vector<trip_match> search(const char* from, const char* to, int earliest, int latest, int seats) {
+		std::shared_lock<std::shared_mutex> shared(layout);
+		return fleet.search(from, to, earliest, latest, seats);
+	}
+
+	//seats taken anywhere between two stops, all of them for a bad bus or leg
+	seat_map seats(int bus, int from = 0, int to = -1) const {
+		if (!exists(bus) || !valid_leg(bus, from, to)) return seat_map(~0u);
+		return fleet.seats_of(bus, from, to);
+	}
+
+	//book a seat from stop 'from' to stop 'to', the whole route by default
+	book_status book(int bus, int seat, const char* name, int from = 0, int to = -1) {
+		if (!exists(bus)) return BOOK_NO_BUS;
+		if (!seat_map::valid(seat) || !valid_leg(bus, from, to)) return BOOK_NO_SEAT;
+		{
+			std::shared_lock<std::shared_mutex> held(gate_of(bus));
+			if (!fleet.claim(bus, seat_map::bit(seat), from, to)) return BOOK_TAKEN;
+			if (!log_book(name, bus, seat_map::bit(seat), from, to))
+			{
+				fleet.release(bus, seat_map::bit(seat), from, to);
+				return BOOK_NOT_SAVED;
+			}
+			fleet.set_passenger(bus, seat, name, from, to);
+		}
+		checkpoint_if_due();
+		return BOOK_OK;
+	}
+
+	//book n seats side by side in one row of a bus, 'first' gets the lowest
+	book_status book_adjacent(int bus, int n, const char* name, int& first, int from = 0, int to = -1) {
+		if (!exists(bus)) return BOOK_NO_BUS;
+		if (run_starts(n) == 0 || !valid_leg(bus, from, to)) return BOOK_NO_SEAT;
+		{
+			std::shared_lock<std::shared_mutex> held(gate_of(bus));
+			first = fleet.claim_adjacent(bus, n, from, to);
+			if (first == 0) return BOOK_TAKEN;
+			if (!log_book(name, bus, seat_map::run(first, n), from, to))
+			{
+				fleet.release(bus, seat_map::run(first, n), from, to);
+				return BOOK_NOT_SAVED;
+			}
+			name_seats(bus, seat_map::run(first, n), name, from, to);
+		}
+		checkpoint_if_due();
+		return BOOK_OK;
+	}
+
+	//book every seat of every request for one passenger, or none of them.
+	//each bus may appear once
+	book_status book_all(const seat_request* requests, int n, const char* name) {
+		std::vector<int> to(n);
+		std::vector<int> held_gates;
+		for (int i = 0; i < n; i++)
+		{
+			if (!exists(requests[i].bus)) return BOOK_NO_BUS;
+			to[i] = requests[i].to;
+			if (requests[i].seats == 0 || !valid_leg(requests[i].bus, requests[i].from, to[i])) return BOOK_NO_SEAT;
+			held_gates.push_back(requests[i].bus % GATES);
+		}
+		//gates in order, as checkpoint() takes them
+		std::sort(held_gates.begin(), held_gates.end());
+		held_gates.erase(std::unique(held_gates.begin(), held_gates.end()), held_gates.end());
+		{
+			std::vector<std::shared_lock<std::shared_mutex>> held;
+			for (int g : held_gates) held.emplace_back(gates[g].lock);
+			for (int i = 0; i < n; i++)
+			{
+				if (fleet.claim(requests[i].bus, requests[i].seats, requests[i].from, to[i])) continue;
+				while (i-- > 0) fleet.release(requests[i].bus, requests[i].seats, requests[i].from, to[i]);
+				return BOOK_TAKEN;
+			}
+			std::vector<journal_leg> legs(n);
+			for (int i = 0; i < n; i++) legs[i] = { requests[i].bus, requests[i].seats, (int8_t)requests[i].from, (int8_t)to[i] };
+			if (!log_book(name, legs.data(), n))
+			{
+				for (int i = 0; i < n; i++) fleet.release(requests[i].bus, requests[i].seats, requests[i].from, to[i]);
+				return BOOK_NOT_SAVED;
+			}
+			for (int i = 0; i < n; i++) name_seats(requests[i].bus, requests[i].seats, name, requests[i].from, to[i]);
+		}
+		checkpoint_if_due();
+		return BOOK_OK;
+	}
+
+	//cancel the booking of a seat that starts at stop 'from'
+	book_status cancel(int bus, int seat, int from = 0) {
+		if (!exists(bus)) return BOOK_NO_BUS;
+		if (!seat_map::valid(seat)) return BOOK_NO_SEAT;
+		{
+			std::shared_lock<std::shared_mutex> held(gate_of(bus));
+			int to;
+			passenger_name was = fleet.passenger(bus, seat, from);
+			if (!fleet.take_passenger(bus, seat, from, to)) return BOOK_NOT_RESERVED;
+			if (!log_cancel(bus, seat, from))
+			{
+				fleet.set_passenger(bus, seat, was.name, from, to);
+				return BOOK_NOT_SAVED;
+			}
+			fleet.release(bus, seat_map::bit(seat), from, to);
+		}
+		checkpoint_if_due();
+		return BOOK_OK;
+	}
+};
+
+#endif //BUS_BOOKINGENGINE_H
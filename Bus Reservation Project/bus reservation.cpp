@@ -1,27 +1,36 @@
+#ifdef _WIN32
 #include <conio.h>
+#endif
 #include <cstdio>
 #include <iostream>
+#include <iomanip>
 #include <string.h>
+#include <string>
+#include <vector>
 #include <cstdlib>
+#include "bookingEngine.h"
+#include "loadTest.h"
+#include "requestServer.h"
 using namespace std;
 
-//Index for the position of the array "bus[p]"
-static int p = 0;
+//every installed bus, see fleetStore.h, and the bookings on them, kept in
+//these files between runs
+static fleet_store fleet;
+static booking_engine engine(fleet);
+static const char SNAPSHOT_FILE[] = "buses.snap";
+static const char JOURNAL_FILE[] = "buses.journal";
 
 //Object class
 class a
 {
-	char busn[5], driver[10], arrival[5], depart[5], from[10], to[10], seat[8][4][10];
 public:
 	void install();
 	void allotment();
-	void empty();
 	void show();
 	void avail();
+	void search();
 	void position(int i);
-}
-
-bus[10];
+};
 
 //To divide
 void vline(char ch) {
@@ -34,145 +43,189 @@ void vline(char ch) {
 
 //Getting the information ready on the bus
 void a::install() {
+	trip_info t;
+	memset(&t, 0, sizeof(t));
 	cout << "Enter bus no --> ";
-	cin >> bus[p].busn;
+	cin >> setw(sizeof(t.busn)) >> t.busn;
+	if (fleet.find(t.busn) >= 0)
+	{
+		cout << "This bus no. is already installed." << endl;
+		return;
+	}
 
 	cout << "\nEnter Driver's name --> ";
-	cin >> bus[p].driver;
+	cin >> setw(sizeof(t.driver)) >> t.driver;
 
 	cout << "\nArrival time --> ";
-	cin >> bus[p].arrival;
+	cin >> setw(sizeof(t.arrival)) >> t.arrival;
 
-	cout << "\nDepature --> ";
-	cin >> bus[p].depart;
+	cout << "\nDepature (HH:MM) --> ";
+	cin >> setw(sizeof(t.depart)) >> t.depart;
+	int minutes;
+	if (!parse_time(t.depart, minutes))
+	{
+		cout << "Enter the departure time as HH:MM." << endl;
+		return;
+	}
 
 	cout << "\nFrom -->  \t\t\t";
-	cin >> bus[p].from;
+	cin >> setw(sizeof(t.from)) >> t.from;
 
 	cout << "\nTo --> \t\t\t";
-	cin >> bus[p].to;
-
-	bus[p].empty();
+	cin >> setw(sizeof(t.to)) >> t.to;
+
+	//a seat can be sold again from every stop on the way
+	int count;
+	vector<string> stops;
+	cout << "\nStops on the way (0 for none) --> ";
+	cin >> count;
+	if (count < 0 || count > MAX_STOPS - 2)
+	{
+		cout << "A bus can stop at most " << MAX_STOPS - 2 << " times on the way." << endl;
+		return;
+	}
+	for (int i = 1; i <= count; i++)
+	{
+		char place[NAME_SIZE];
+		cout << "Stop " << i << " --> ";
+		cin >> setw(sizeof(place)) >> place;
+		stops.push_back(place);
+	}
 
-	p++;
+	if (engine.install(t, stops) == -2) cout << book_message(BOOK_NOT_SAVED) << endl;
 }
 
 //asigning a seat and bus
 void a::allotment() {
 	int seat;
-	char number[5];
+	char number[BUS_NUMBER_SIZE];
 top:
 	cout << "Bus no --> ";
-	cin >> number;
-	int n;
+	cin >> setw(sizeof(number)) >> number;
+	int n = fleet.find(number);
 
-	for (n = 0; n <= p; n++)
+	//where the passenger gets on and off, on a bus that stops on the way
+	int from = 0, to = -1;
+	if (n >= 0 && fleet.stops(n) > 2)
 	{
-		if (strcmp(bus[n].busn, number) == 0)
-			break;
+		char place[NAME_SIZE];
+		cout << "Boarding at --> ";
+		cin >> setw(sizeof(place)) >> place;
+		from = engine.find_stop(n, place);
+		cout << "Leaving at --> ";
+		cin >> setw(sizeof(place)) >> place;
+		to = engine.find_stop(n, place);
+		if (from < 0 || to <= from)
+		{
+			cout << "The bus does not go between these stops." << endl;
+			return;
+		}
 	}
 
-	while (n <= p)
+	while (n >= 0)
 	{
 		cout << "\nSeat Number --> ";
 		cin >> seat;
 
-		if (seat > 32)
+		if (!seat_map::valid(seat))
 		{
-			cout << "\nThere are only 32 seats available in this bus.";
+			cout << "\nThere are only " << SEATS << " seats available in this bus.";
 		}
 		else
 		{
-			if (strcmp(bus[n].seat[seat / 4][(seat % 4) - 1], "Empty") == 0)
+			seat_map seats = fleet.seats_of(n, from, to);
+			if (seats.is_free(seat))
 			{
+				char name[NAME_SIZE];
 				cout << "Enter passenger's name --> ";
-				cin >> bus[n].seat[seat / 4][(seat % 4) - 1];
+				cin >> setw(sizeof(name)) >> name;
+				book_status status = engine.book(n, seat, name, from, to);
+				if (status != BOOK_OK) cout << book_message(status) << endl;
+				break;
+			}
+			else if (seats.first_free() == 0)
+			{
+				cout << "The bus is full." << endl;
 				break;
 			}
 			else
-				cout << "The seat no. is already reserved." << endl;
+				cout << "The seat no. is already reserved, seat no. " << seats.first_free() << " is free." << endl;
 		}
 
 	}
-	if (n > p)
+	if (n < 0)
 	{
 		cout << "Enter correct bus no." << endl;
 		goto top;
 	}
 }
-void a::empty() {
-	for (int i = 0; i < 8; i++)
-	{
-		for (int j = 0; j < 4; j++) {
-			strcpy_s(bus[p].seat[i][j], "Empty");
-		}
-
-	}
-}
 
 void a::show() {
 	int n;
-	char number[5];
+	char number[BUS_NUMBER_SIZE];
 
 	cout << "Enter bus no:";
-	cin >> number;
-
-	for (n = 0; n <= p; n++)
-	{
-		if (strcmp(bus[n].busn, number) == 0)
-			break;
-	}
+	cin >> setw(sizeof(number)) >> number;
+	n = fleet.find(number);
 
-	while (n <= p)
+	while (n >= 0)
 	{
+		const trip_info& t = fleet.trip(n);
 		vline('*');
-		cout << "Bus no --> \t" << bus[n].busn
-			<< "\nDriver --> \t" << bus[n].driver
-			<< "\t\tArrival time --> \t" << bus[n].arrival << "\tDeparture time: "
-			<< bus[n].depart << "\nFrom --> \t\t" << bus[n].from
-			<< "\t\tTo --> \t\t" << bus[n].to << "\n";
+		cout << "Bus no --> \t" << t.busn
+			<< "\nDriver --> \t" << t.driver
+			<< "\t\tArrival time --> \t" << t.arrival << "\tDeparture time: "
+			<< t.depart << "\nFrom --> \t\t" << t.from
+			<< "\t\tTo --> \t\t" << t.to << "\n";
+		int stops = fleet.stops(n);
+		if (stops > 2)
+		{
+			cout << "Stops --> \t";
+			for (int i = 0; i < stops; i++) cout << (i > 0 ? ", " : "") << fleet.stop(n, i);
+			cout << "\n";
+		}
 		vline('*');
 
-		bus[0].position(n);
+		position(n);
 
-		int a = 1;
-		for (int i = 0; i < 8; i++)
+		//walk the seats reserved anywhere on the way, lowest bit first, and
+		//the bookings on each
+		for (uint32_t taken = fleet.seats_of(n).mask(); taken != 0; taken &= taken - 1)
 		{
-			for (int j = 0; j < 4; j++) {
-				a++;
-				if (strcmp(bus[n].seat[i][j], "Empty") != 0)
-				{
-					cout << "\nThe seant no --> " << (a - 1) << " <-- is reserved for --> " << bus[n].seat[i][j] << ". <--";
-				}
+			int s = ctz32(taken) + 1;
+			for (int from = 0; from < stops - 1; from++)
+			{
+				passenger_name p = fleet.passenger(n, s, from);
+				if (p.name[0] == '\0') continue;
+				cout << "\nThe seant no --> " << s << " <-- is reserved for --> " << p.name << ". <--";
+				if (stops > 2) cout << " from " << fleet.stop(n, from) << " to " << fleet.stop(n, p.to);
 			}
-
 		}
 		break;
 	}
-	if (n > p)
+	if (n < 0)
 	{
 		cout << "Enter correct bus no --> ";
 	}
 }
 void a::position(int l) {
 	int s = 0;
-	p = 0;
+	seat_map seats = fleet.seats_of(l);
 
-	for (int i = 0; i < 8; i++)
+	for (int i = 0; i < ROWS; i++)
 	{
 		cout << "\n";
-		for (int j = 0; j < 4; j++)
+		for (int j = 0; j < SEATS_PER_ROW; j++)
 		{
 			s++;
-			if (strcmp(bus[l].seat[i][j], "Empty") == 0)
+			if (seats.is_free(s))
 			{
 				cout.width(5);
 				cout.fill(' ');
 				cout << s << ".";
 				cout.width(10);
 				cout.fill(' ');
-				cout << bus[l].seat[i][j];
-				p++;
+				cout << "Empty";
 			}
 			else
 			{
@@ -181,30 +234,194 @@ void a::position(int l) {
 				cout << ".";
 				cout.width(10);
 				cout.fill(' ');
-				cout << bus[l].seat[i][j];
+				passenger_name p = fleet.passenger(l, s);
+				cout << (p.name[0] != '\0' ? p.name : "Booked");
 			}
 		}
 	}
-	cout << "\n\nThere are  --> " << p << " <-- seats empty in Bus No --> " << bus[l].busn;
+	cout << "\n\nThere are  --> " << seats.free_count() << " <-- seats empty in Bus No --> " << fleet.trip(l).busn;
 }
 
 void a::avail() {
-	for (int n = 0; n < p; n++)
+	for (int n = 0; n < fleet.size(); n++)
 	{
+		const trip_info& t = fleet.trip(n);
 		vline('*');
-		cout << "Bus no --> \t" << bus[n].busn << "\nDriver --> \t" << bus[n].driver
-			<< "\t\tArrival time --> \t" << bus[n].arrival << "\tDeparture time --> \t"
-			<< bus[n].depart << "\nFrom --> \t\t" << bus[n].from << "\t\tTo --> \t\t\t"
-			<< bus[n].to << "\n";
+		cout << "Bus no --> \t" << t.busn << "\nDriver --> \t" << t.driver
+			<< "\t\tArrival time --> \t" << t.arrival << "\tDeparture time --> \t"
+			<< t.depart << "\nFrom --> \t\t" << t.from << "\t\tTo --> \t\t\t"
+			<< t.to << "\n";
 		vline('*');
 		vline('_');
 	}
 }
 
 
-int main() {
+//buses of a route leaving within a time window with enough free seats
+void a::search() {
+	char from[NAME_SIZE], to[NAME_SIZE], earliest[TIME_SIZE], latest[TIME_SIZE];
+	int seats, first, last;
+
+	cout << "From --> ";
+	cin >> setw(sizeof(from)) >> from;
+	cout << "To --> ";
+	cin >> setw(sizeof(to)) >> to;
+	cout << "Departing after (HH:MM) --> ";
+	cin >> setw(sizeof(earliest)) >> earliest;
+	cout << "Departing before (HH:MM) --> ";
+	cin >> setw(sizeof(latest)) >> latest;
+	cout << "Seats needed --> ";
+	cin >> seats;
+	if (!parse_time(earliest, first) || !parse_time(latest, last))
+	{
+		cout << "Enter the times as HH:MM." << endl;
+		return;
+	}
+
+	vector<trip_match> found = engine.search(from, to, first, last, seats);
+	cout << "\n" << found.size() << " bus(es) found\n";
+	for (const trip_match& m : found)
+	{
+		trip_info t;
+		if (!engine.trip(m.bus, t)) continue;
+		vline('*');
+		cout << "Bus no --> \t" << t.busn << "\tDeparture time --> \t" << t.depart
+			<< "\tArrival time --> \t" << t.arrival << "\nSeats free --> \t" << m.free << "\n";
+	}
+	vline('_');
+}
+
+//run commands without the menu, see requestServer.h.
+//	--batch [file]   from a file, or stdin without one or for -
+//	--socket <path>  from the clients of a unix socket
+int batch(int argc, char** argv) {
+	request_processor requests(fleet, engine);
+	string mode = argv[1];
+	if (mode == "--batch" && argc <= 3)
+	{
+		int in = 0;
+		if (argc == 3 && strcmp(argv[2], "-") != 0)
+		{
+			FILE* f = fopen(argv[2], "rb");
+			if (f == NULL)
+			{
+				cerr << "Can not open " << argv[2] << "." << endl;
+				return 1;
+			}
+			in = fileno(f);
+		}
+		bool ok = requests.serve(in, 1);
+		engine.checkpoint();
+		return ok ? 0 : 1;
+	}
+#ifndef _WIN32
+	if (mode == "--socket" && argc == 3)
+	{
+		if (!requests.serve_socket(argv[2]))
+		{
+			cerr << "Can not listen on " << argv[2] << ", or it is not a socket." << endl;
+			return 1;
+		}
+		return 0;
+	}
+#endif
+	cerr << "usage: " << argv[0] << " [--batch [file] | --socket <path>]" << endl;
+	cerr << "   or: " << argv[0] << " --load-test [buses] [threads] [operations per thread] [search,show,hold,book,cancel %] [hot %] [fsync batch]" << endl;
+	return 1;
+}
+
+//time a mix of bookings on a synthetic fleet, see loadTest.h. with an fsync
+//batch the bookings go through a journal in scratch files, as they do in use
+int load(int argc, char** argv) {
+	const char* files[] = { "loadtest.snap", "loadtest.journal" };
+	load_options opt;
+	journal_options journal;
+	journal.sync_entries = 0;
+	if (argc > 2) opt.buses = atoi(argv[2]);
+	if (argc > 3) opt.threads = atoi(argv[3]);
+	if (argc > 4) opt.operations = atol(argv[4]);
+	bool mix_ok = true;
+	if (argc > 5)
+	{
+		const char* at = argv[5];
+		for (int op = 0; op < LOAD_OPS && mix_ok; op++)
+		{
+			char* end;
+			opt.mix[op] = (int)strtol(at, &end, 10);
+			mix_ok = end != at && (*end == (op == LOAD_OPS - 1 ? '\0' : ','));
+			at = end + 1;
+		}
+	}
+	if (argc > 6) opt.hot = atoi(argv[6]);
+	if (argc > 7) journal.sync_entries = atoi(argv[7]);
+	int total = 0;
+	for (int op = 0; op < LOAD_OPS; op++) total += opt.mix[op] < 0 ? 1000 : opt.mix[op];
+	if (argc > 8 || opt.buses < 1 || opt.buses >= 100000000 || opt.threads < 1 || opt.operations < 1 || !mix_ok || total != 100
+		|| opt.hot < 0 || opt.hot > 100 || journal.sync_entries < 0)
+	{
+		cerr << "usage: " << argv[0] << " --load-test [buses] [threads] [operations per thread] [search,show,hold,book,cancel %] [hot %] [fsync batch]" << endl;
+		cerr << "\tthe mix is 5 percentages adding up to 100, 30,20,10,25,15 by default. hot is the share" << endl;
+		cerr << "\tof operations on bus 0. with an fsync batch of n, every booking goes to a journal fsynced each n entries" << endl;
+		return 2;
+	}
+
+	load_result result;
+	for (const char* f : files) remove(f);
+	{
+		fleet_store scratch;
+		booking_engine scratch_engine(scratch);
+		if (journal.sync_entries > 0 && !scratch_engine.open(files[0], files[1], journal))
+		{
+			cerr << "Can not open " << files[1] << "." << endl;
+			return 1;
+		}
+		load_test test(scratch, scratch_engine);
+		if (!test.build(opt))
+		{
+			cerr << "Can not install the buses." << endl;
+			return 1;
+		}
+		test.run(opt, result);
+	}
+	for (const char* f : files) remove(f);
+
+	cerr << result.operations << " operation(s) on " << opt.buses << " buses from " << opt.threads
+		<< " thread(s) in " << result.seconds << " s";
+	if (result.seconds > 0) cerr << " (" << (long long)(result.operations / result.seconds) << " operations/s)";
+	cerr << endl;
+	char line[160];
+	snprintf(line, sizeof(line), "%-7s %9s %8s %9s %9s %9s %9s %9s %9s",
+		"op", "count", "missed", "p50 us", "p90 us", "p99 us", "p99.9 us", "p99.99 us", "max us");
+	cerr << line << endl;
+	for (int op = 0; op < LOAD_OPS; op++)
+	{
+		const latency_histogram& h = result.ops[op].latency;
+		if (h.count() == 0) continue;
+		snprintf(line, sizeof(line), "%-7s %9ld %8ld %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f",
+			load_op_name(op), (long)h.count(), result.ops[op].missed, h.percentile(0.50) / 1000.0, h.percentile(0.90) / 1000.0,
+			h.percentile(0.99) / 1000.0, h.percentile(0.999) / 1000.0, h.percentile(0.9999) / 1000.0, h.max() / 1000.0);
+		cerr << line << endl;
+	}
+	cerr << result.passengers << " passenger(s) left, " << result.expected << " expected; " << result.double_booked
+		<< " seat segment(s) booked twice, " << result.unnamed << " reserved without a passenger or the other way round" << endl;
+	bool clean = result.double_booked == 0 && result.unnamed == 0 && result.passengers == result.expected;
+	cerr << (clean ? "bookings consistent" : "BOOKINGS INCONSISTENT") << endl;
+	return clean ? 0 : 3;
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "--load-test") == 0) return load(argc, argv);
+	if (!engine.open(SNAPSHOT_FILE, JOURNAL_FILE))
+	{
+		cerr << "Can not read the reservations in " << SNAPSHOT_FILE << " and " << JOURNAL_FILE << "." << endl;
+		return 1;
+	}
+	if (argc > 1) return batch(argc, argv);
+#ifdef _WIN32
 	system("cls");
+#endif
 	int w;
+	a bus;
 
 	while (1)
 	{
@@ -214,21 +431,25 @@ int main() {
 			<< "2.Reservation\n\t\t\t\t\t"
 			<< "3.Show\n\t\t\t\t\t"
 			<< "4.Buses Available. \n\t\t\t\t\t"
-			<< "5.Exit";
+			<< "5.Search Buses\n\t\t\t\t\t"
+			<< "6.Exit";
 		cout << "\n\t\t\t\t\tEnter your choice -> ";
 		cin >> w;
 
 		switch (w)
 		{
-		case 1: bus[p].install();
+		case 1: bus.install();
+			break;
+		case 2: bus.allotment();
 			break;
-		case 2: bus[p].allotment();
+		case 3: bus.show();
 			break;
-		case 3: bus[0].show();
+		case 4: bus.avail();
 			break;
-		case 4: bus[0].avail();
+		case 5: bus.search();
 			break;
-		case 5: exit(0);
+		case 6: engine.checkpoint();
+			exit(0);
 			break;
 		}
 	}
@@ -0,0 +1,36 @@
+//index from bus number to the position of the bus in the fleet, so finding a
+//bus costs one hash lookup however many buses are installed. a bus number
+//can only be installed once
+
+#ifndef BUS_BUSINDEX_H
+#define BUS_BUSINDEX_H
+
+#include <string>
+#include <unordered_map>
+
+class bus_index
+{
+private:
+	std::unordered_map<std::string, int> positions;
+
+public:
+	void clear() { positions.clear(); }
+
+	//make room for n buses up front, so installing them never rehashes
+	void reserve(size_t n) { positions.reserve(n); }
+
+	int size() const { return (int)positions.size(); }
+
+	//false if the number is installed already
+	bool insert(const char* number, int position) {
+		return positions.emplace(number, position).second;
+	}
+
+	//position of a bus, -1 if no bus has this number
+	int find(const char* number) const {
+		auto it = positions.find(number);
+		return it == positions.end() ? -1 : it->second;
+	}
+};
+
+#endif //BUS_BUSINDEX_H
@@ -0,0 +1,160 @@
+//the whole fleet written to one file: the trip details and stops of every
+//bus, the reserved seats of every segment and the passenger names, along
+//with the sequence number of the last journal entry it holds, see
+//reservationJournal.h. a snapshot is built in memory while the fleet is held
+//still and written out after, to a new file that then replaces the old one,
+//so there is always one whole snapshot on disk. the file ends with a
+//checksum of everything before it
+
+#ifndef BUS_FLEETSNAPSHOT_H
+#define BUS_FLEETSNAPSHOT_H
+
+#include "fleetStore.h"
+#include "reservationJournal.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const char SNAPSHOT_MAGIC[8] = { 'B', 'U', 'S', 'S', 'N', 'A', 'P', '1' };
+
+namespace snapshot_detail
+{
+	template <class T>
+	void put(std::vector<char>& out, const T& value) {
+		const char* p = (const char*)&value;
+		out.insert(out.end(), p, p + sizeof(T));
+	}
+
+	//reads values off the bytes of a snapshot, false once they run out
+	struct reader
+	{
+		const char* at;
+		const char* end;
+
+		template <class T>
+		bool get(T& value) {
+			if ((size_t)(end - at) < sizeof(T)) return false;
+			memcpy(&value, at, sizeof(T));
+			at += sizeof(T);
+			return true;
+		}
+	};
+}
+
+//the fleet as the bytes of a snapshot file, 'seq' being the last journal
+//entry it holds. nothing may change the fleet meanwhile
+inline std::vector<char> take_snapshot(const fleet_store& fleet, uint64_t seq) {
+	using snapshot_detail::put;
+	std::vector<char> out(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + sizeof(SNAPSHOT_MAGIC));
+	put(out, seq);
+	int buses = fleet.size();
+	put(out, (uint32_t)buses);
+	for (int bus = 0; bus < buses; bus++)
+	{
+		put(out, fleet.trip(bus));
+		int stops = fleet.stops(bus);
+		put(out, (uint8_t)stops);
+		for (int i = 1; i < stops - 1; i++)
+		{
+			char name[NAME_SIZE] = {};
+			const char* stop = fleet.stop(bus, i);
+			memcpy(name, stop, strnlen(stop, NAME_SIZE - 1));
+			put(out, name);
+		}
+		for (int k = 0; k < stops - 1; k++) put(out, fleet.segment_mask(bus, k));
+	}
+	size_t counted = out.size();
+	put(out, (uint64_t)0);
+	uint64_t bookings = 0;
+	fleet.each_passenger([&](int bus, int seat, int from, const passenger_name& p) {
+		put(out, (int32_t)bus);
+		put(out, (uint8_t)seat);
+		put(out, (uint8_t)from);
+		put(out, p);
+		bookings++;
+		});
+	memcpy(&out[counted], &bookings, sizeof(bookings));
+	put(out, fnv32(out.data(), out.size()));
+	return out;
+}
+
+//write a snapshot to 'path', through a new file that replaces the old one
+//once it is on the disk
+inline bool save_snapshot(const char* path, const std::vector<char>& image) {
+	std::string temp = std::string(path) + ".tmp";
+	FILE* f = fopen(temp.c_str(), "wb");
+	if (f == nullptr) return false;
+	bool ok = fwrite(image.data(), 1, image.size(), f) == image.size() && sync_file(f);
+	fclose(f);
+	if (!ok || !replace_file(temp.c_str(), path))
+	{
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+//fill an empty fleet from the snapshot at 'path' and set 'seq' to the last
+//journal entry it holds. with no snapshot there the fleet stays empty and
+//'seq' is 0. false if the file can not be read or is damaged
+inline bool load_snapshot(const char* path, fleet_store& fleet, uint64_t& seq) {
+	seq = 0;
+	FILE* f = fopen(path, "rb");
+	if (f == nullptr) return true;
+	std::vector<char> image;
+	char block[1 << 16];
+	size_t n;
+	while ((n = fread(block, 1, sizeof(block), f)) > 0) image.insert(image.end(), block, block + n);
+	bool read = ferror(f) == 0;
+	fclose(f);
+	uint32_t check;
+	if (!read || image.size() < sizeof(SNAPSHOT_MAGIC) + sizeof(check)) return false;
+	memcpy(&check, &image[image.size() - sizeof(check)], sizeof(check));
+	if (memcmp(image.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || fnv32(image.data(), image.size() - sizeof(check)) != check)
+		return false;
+
+	snapshot_detail::reader in = { image.data() + sizeof(SNAPSHOT_MAGIC), image.data() + image.size() - sizeof(check) };
+	uint32_t buses;
+	if (!in.get(seq) || !in.get(buses)) return false;
+	fleet.reserve(buses);
+	std::vector<std::string> on_the_way;
+	for (uint32_t bus = 0; bus < buses; bus++)
+	{
+		trip_info trip;
+		uint8_t stops;
+		if (!in.get(trip) || !in.get(stops) || stops < 2 || stops > MAX_STOPS) return false;
+		on_the_way.clear();
+		for (int i = 1; i < stops - 1; i++)
+		{
+			char name[NAME_SIZE];
+			if (!in.get(name)) return false;
+			name[NAME_SIZE - 1] = '\0';
+			on_the_way.push_back(name);
+		}
+		if (fleet.add(trip, on_the_way) != (int)bus) return false;
+		for (int k = 0; k < stops - 1; k++)
+		{
+			uint32_t mask;
+			if (!in.get(mask)) return false;
+			if (mask != 0) fleet.mark(bus, mask, k, k + 1);
+		}
+	}
+	uint64_t bookings;
+	if (!in.get(bookings)) return false;
+	for (uint64_t i = 0; i < bookings; i++)
+	{
+		int32_t bus;
+		uint8_t seat, from;
+		passenger_name p;
+		if (!in.get(bus) || !in.get(seat) || !in.get(from) || !in.get(p)) return false;
+		if (bus < 0 || bus >= fleet.size() || !seat_map::valid(seat) || from >= p.to || p.to >= fleet.stops(bus)) return false;
+		p.name[NAME_SIZE - 1] = '\0';
+		fleet.set_passenger(bus, seat, p.name, from, p.to);
+	}
+	return true;
+}
+
+#endif //BUS_FLEETSNAPSHOT_H
@@ -0,0 +1,337 @@
+//every bus of the fleet, stored as columns instead of one object per bus:
+//the trip details that are only read for display, the seat bitmaps that
+//availability scans run over, and the passenger names, each in an array of
+//its own. a scan of the free seats reads 4 bytes per bus and nothing else.
+//names are only stored for seats that are actually reserved, so memory grows
+//with the bookings rather than with the seats of every bus
+//
+//the seat words are atomic and live in fixed chunks that never move, so
+//seats can be claimed and released from many threads at once with a
+//compare and swap on the word of the bus, see bookingEngine.h. adding a bus
+//and reading the trip details or the bus number index still need the store
+//to themselves, or at least no add() running
+//
+//buses are also indexed by route and departure time, see routeIndex.h.
+//a bus that stops on the way keeps its seats per segment between stops
+//instead of in its seat word, see segmentMap.h. every call that takes a
+//'from' and 'to' stop works on the part of the route between them, stop 0
+//being where the bus starts and -1 standing for where it ends; a bus
+//without stops has just the two
+
+#ifndef BUS_FLEETSTORE_H
+#define BUS_FLEETSTORE_H
+
+#include "busIndex.h"
+#include "routeIndex.h"
+#include "seatMap.h"
+#include "segmentMap.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const int BUS_NUMBER_SIZE = 10;
+const int NAME_SIZE = 10;
+const int TIME_SIZE = 6;
+
+//what is known about a bus apart from its seats
+struct trip_info
+{
+	char busn[BUS_NUMBER_SIZE];
+	char driver[NAME_SIZE];
+	char arrival[TIME_SIZE];
+	char depart[TIME_SIZE];
+	char from[NAME_SIZE];
+	char to[NAME_SIZE];
+};
+
+struct passenger_name
+{
+	char name[NAME_SIZE];
+	int8_t to; //stop where the passenger leaves
+};
+
+//a bus found by fleet_store::search
+struct trip_match
+{
+	int bus;
+	int depart; //minutes after midnight
+	int free;   //seats free when it was found
+};
+
+class fleet_store
+{
+private:
+	//seat words per chunk, and the most chunks there can be
+	static const int CHUNK_BITS = 12;
+	static const int CHUNK = 1 << CHUNK_BITS;
+	static const int MAX_CHUNKS = 1 << 15;
+	static const int NAME_SHARDS = 64;
+
+	//names of the reserved seats of every NAME_SHARDS-th bus, under a lock of
+	//their own so bookings on different buses rarely meet
+	struct alignas(64) name_shard
+	{
+		std::mutex lock;
+		std::unordered_map<uint64_t, passenger_name> names; //bus * SEATS + seat - 1 -> name
+	};
+
+	//the seat words of CHUNK buses, and the segments of those that stop on
+	//the way, null for the others
+	struct chunk
+	{
+		std::atomic<uint32_t> words[CHUNK];
+		segment_map* segments[CHUNK];
+	};
+
+	std::vector<trip_info> trips;
+	std::unique_ptr<std::unique_ptr<chunk>[]> chunks;
+	std::vector<std::unique_ptr<segment_map>> stopping; //owns the segment maps
+	std::unique_ptr<name_shard[]> shards;
+	std::atomic<int> count{ 0 };
+	bus_index by_number;
+	route_index routes;
+
+	//a booking is found by its bus, seat and the stop it starts at
+	static uint64_t name_key(int bus, int seat, int from) {
+		return ((uint64_t)bus * SEATS + (uint64_t)(seat - 1)) * MAX_STOPS + (uint64_t)from;
+	}
+
+	std::atomic<uint32_t>& word(int bus) const { return chunks[bus >> CHUNK_BITS]->words[bus & (CHUNK - 1)]; }
+
+	segment_map* segments(int bus) const { return chunks[bus >> CHUNK_BITS]->segments[bus & (CHUNK - 1)]; }
+
+	//the last stop for -1
+	int last(int bus, int to) const { return to >= 0 ? to : stops(bus) - 1; }
+
+	name_shard& shard(int bus) const { return shards[bus % NAME_SHARDS]; }
+
+public:
+	fleet_store() : chunks(new std::unique_ptr<chunk>[MAX_CHUNKS]), shards(new name_shard[NAME_SHARDS]) {}
+
+	//make room for n buses up front
+	void reserve(size_t n) {
+		trips.reserve(n);
+		by_number.reserve(n);
+	}
+
+	int size() const { return count.load(std::memory_order_acquire); }
+
+	//add a bus with every seat free, returns its position or -1 when the
+	//bus number is installed already. 'on_the_way' are the stops between
+	//trip.from and trip.to, at most MAX_STOPS - 2. a bus whose departure is
+	//not a time, see parse_time, is left out of the route index
+	int add(const trip_info& trip, const std::vector<std::string>& on_the_way = std::vector<std::string>()) {
+		int bus = size();
+		if (bus >= MAX_CHUNKS * CHUNK) throw std::length_error("fleet_store is full");
+		if (on_the_way.size() > MAX_STOPS - 2) throw std::length_error("too many stops on the way");
+		if (!by_number.insert(trip.busn, bus)) return -1;
+		trips.push_back(trip);
+		std::unique_ptr<chunk>& c = chunks[bus >> CHUNK_BITS];
+		if (!c)
+		{
+			c.reset(new chunk);
+			for (int i = 0; i < CHUNK; i++)
+			{
+				c->words[i].store(0, std::memory_order_relaxed);
+				c->segments[i] = nullptr;
+			}
+		}
+		if (!on_the_way.empty())
+		{
+			std::vector<std::string> all(1, trip.from);
+			all.insert(all.end(), on_the_way.begin(), on_the_way.end());
+			all.push_back(trip.to);
+			stopping.emplace_back(new segment_map(all));
+			c->segments[bus & (CHUNK - 1)] = stopping.back().get();
+		}
+		int depart;
+		if (parse_time(trip.depart, depart)) routes.insert(trip.from, trip.to, depart, bus);
+		count.store(bus + 1, std::memory_order_release);
+		return bus;
+	}
+
+	//position of a bus, -1 if no bus has this number
+	int find(const char* number) const { return by_number.find(number); }
+
+	const trip_info& trip(int bus) const { return trips[bus]; }
+
+	//stops of a bus, both ends included
+	int stops(int bus) const {
+		segment_map* s = segments(bus);
+		return s != nullptr ? s->stops() : 2;
+	}
+
+	//name of a stop of a bus
+	const char* stop(int bus, int i) const {
+		segment_map* s = segments(bus);
+		if (s != nullptr) return s->stop(i).c_str();
+		return i == 0 ? trips[bus].from : trips[bus].to;
+	}
+
+	//position of a stop of a bus, -1 if the bus does not stop there
+	int find_stop(int bus, const char* place) const {
+		segment_map* s = segments(bus);
+		if (s != nullptr) return s->find_stop(place);
+		if (same_place(trips[bus].from, place)) return 0;
+		return same_place(trips[bus].to, place) ? 1 : -1;
+	}
+
+	//the seats of a bus as they are at this moment, a seat counting as
+	//reserved when it is on any part of the way between the two stops
+	seat_map seats_of(int bus, int from = 0, int to = -1) const {
+		segment_map* s = segments(bus);
+		if (s != nullptr) return s->seats(from, last(bus, to));
+		return seat_map(word(bus).load(std::memory_order_acquire));
+	}
+
+	//reserve every seat in 'mask' at once, false and nothing reserved if
+	//any of them is taken
+	bool claim(int bus, uint32_t mask, int from = 0, int to = -1) {
+		segment_map* s = segments(bus);
+		if (s != nullptr) return s->claim(mask, from, last(bus, to));
+		std::atomic<uint32_t>& w = word(bus);
+		uint32_t seen = w.load(std::memory_order_relaxed);
+		do
+		{
+			if ((seen & mask) != 0) return false;
+		} while (!w.compare_exchange_weak(seen, seen | mask, std::memory_order_acq_rel, std::memory_order_relaxed));
+		return true;
+	}
+
+	//reserve the lowest run of n free seats side by side in a row, returns
+	//its first seat or 0 when there is none
+	int claim_adjacent(int bus, int n, int from = 0, int to = -1) {
+		segment_map* s = segments(bus);
+		if (s != nullptr) return s->claim_adjacent(n, from, last(bus, to));
+		std::atomic<uint32_t>& w = word(bus);
+		uint32_t seen = w.load(std::memory_order_relaxed);
+		while (true)
+		{
+			int first = seat_map(seen).find_adjacent(n);
+			if (first == 0) return 0;
+			if (w.compare_exchange_weak(seen, seen | seat_map::run(first, n), std::memory_order_acq_rel, std::memory_order_relaxed))
+				return first;
+		}
+	}
+
+	//reserve every seat in 'mask' whether or not it is free, for rebuilding
+	//the fleet from a snapshot or journal
+	void mark(int bus, uint32_t mask, int from = 0, int to = -1) {
+		segment_map* s = segments(bus);
+		if (s != nullptr) s->mark(mask, from, last(bus, to));
+		else word(bus).fetch_or(mask, std::memory_order_acq_rel);
+	}
+
+	//seats reserved on one segment of a bus, the seat word for a bus that
+	//does not stop on the way
+	uint32_t segment_mask(int bus, int segment) const {
+		segment_map* s = segments(bus);
+		if (s != nullptr) return s->seats(segment, segment + 1).mask();
+		return word(bus).load(std::memory_order_acquire);
+	}
+
+	//free every seat in 'mask'
+	void release(int bus, uint32_t mask, int from = 0, int to = -1) {
+		segment_map* s = segments(bus);
+		if (s != nullptr) s->release(mask, from, last(bus, to));
+		else word(bus).fetch_and(~mask, std::memory_order_acq_rel);
+	}
+
+	//store the passenger of a seat this thread has claimed
+	void set_passenger(int bus, int seat, const char* name, int from = 0, int to = -1) {
+		name_shard& s = shard(bus);
+		std::lock_guard<std::mutex> guard(s.lock);
+		passenger_name& p = s.names[name_key(bus, seat, from)];
+		size_t length = strnlen(name, NAME_SIZE - 1);
+		memcpy(p.name, name, length);
+		p.name[length] = '\0';
+		p.to = (int8_t)last(bus, to);
+	}
+
+	//reserve a seat for a passenger, false if it is taken or does not exist
+	bool reserve(int bus, int seat, const char* name, int from = 0, int to = -1) {
+		if (!seat_map::valid(seat) || !claim(bus, seat_map::bit(seat), from, to)) return false;
+		set_passenger(bus, seat, name, from, to);
+		return true;
+	}
+
+	//remove the passenger of a seat who boards at stop 'from', 'to' gets
+	//the stop where they would have left. false if there is none. the seat
+	//itself stays reserved until it is released
+	bool take_passenger(int bus, int seat, int from, int& to) {
+		if (!seat_map::valid(seat)) return false;
+		name_shard& s = shard(bus);
+		std::lock_guard<std::mutex> guard(s.lock);
+		auto it = s.names.find(name_key(bus, seat, from));
+		if (it == s.names.end()) return false;
+		to = it->second.to;
+		s.names.erase(it);
+		return true;
+	}
+
+	//free the seat of the passenger who boards at stop 'from', false if there
+	//is none. the name goes first, so it can not remove the name of whoever
+	//books the seat next
+	bool cancel(int bus, int seat, int from = 0) {
+		int to;
+		if (!take_passenger(bus, seat, from, to)) return false;
+		release(bus, seat_map::bit(seat), from, to);
+		return true;
+	}
+
+	//call visit(bus, seat, from, passenger) for every booking, in no order.
+	//bookings made meanwhile may or may not be visited
+	template <class F>
+	void each_passenger(F visit) const {
+		for (int i = 0; i < NAME_SHARDS; i++)
+		{
+			std::lock_guard<std::mutex> guard(shards[i].lock);
+			for (const auto& e : shards[i].names)
+			{
+				uint64_t seat = e.first / MAX_STOPS;
+				visit((int)(seat / SEATS), (int)(seat % SEATS) + 1, (int)(e.first % MAX_STOPS), e.second);
+			}
+		}
+	}
+
+	//passenger on a seat who boards at stop 'from', with an empty name when
+	//there is none
+	passenger_name passenger(int bus, int seat, int from = 0) const {
+		passenger_name p;
+		p.name[0] = '\0';
+		p.to = 0;
+		name_shard& s = shard(bus);
+		std::lock_guard<std::mutex> guard(s.lock);
+		auto it = s.names.find(name_key(bus, seat, from));
+		if (it != s.names.end()) p = it->second;
+		return p;
+	}
+
+	//buses from 'from' to 'to' leaving between 'earliest' and 'latest'
+	//minutes after midnight with at least 'seats' seats free, earliest first
+	std::vector<trip_match> search(const char* from, const char* to, int earliest, int latest, int seats) const {
+		std::vector<trip_match> found;
+		routes.find(from, to, earliest, latest, [&](int depart, int bus) {
+			int free = seats_of(bus).free_count();
+			if (free >= seats) found.push_back({ bus, depart, free });
+			});
+		return found;
+	}
+
+	//free seats over the whole fleet, a popcount per bus
+	long free_seats() const {
+		long total = 0;
+		int n = size();
+		for (int bus = 0; bus < n; bus++) total += seats_of(bus).free_count();
+		return total;
+	}
+};
+
+#endif //BUS_FLEETSTORE_H
@@ -0,0 +1,376 @@
+//load generator for the booking engine. it builds a synthetic fleet and
+//timetable and fires a random mix of what the menu does from worker
+//threads: searching a route, showing a bus with its passengers, holding a
+//run of seats side by side for a party, booking one seat and cancelling a
+//booking the thread made earlier. a share of the operations can be sent to
+//one hot bus and its route, up to everyone wanting the same bus. every
+//operation is timed into a latency histogram of its kind.
+//
+//afterwards the fleet is checked seat by seat: no segment of a seat may be
+//held by two passengers, every reserved seat must have a passenger and every
+//passenger a reserved seat, and the passengers left must be what was booked
+//less what was cancelled
+
+#ifndef BUS_LOADTEST_H
+#define BUS_LOADTEST_H
+
+#include "bookingEngine.h"
+#include "fleetStore.h"
+#include "seatMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum load_op
+{
+	LOAD_SEARCH, //buses of a route within a time window
+	LOAD_SHOW,   //a bus, its seats and passengers
+	LOAD_HOLD,   //2 to 4 seats side by side for a party
+	LOAD_BOOK,   //a seat seen free a moment before
+	LOAD_CANCEL, //a booking or hold this thread made
+	LOAD_OPS,
+};
+
+inline const char* load_op_name(int op) {
+	switch (op)
+	{
+	case LOAD_SEARCH: return "search";
+	case LOAD_SHOW: return "show";
+	case LOAD_HOLD: return "hold";
+	case LOAD_BOOK: return "book";
+	case LOAD_CANCEL: return "cancel";
+	}
+	return "";
+}
+
+//index of the highest set bit, x may not be 0
+inline int msb64(uint64_t x) {
+#ifdef _MSC_VER
+	unsigned long at;
+	_BitScanReverse64(&at, x);
+	return (int)at;
+#else
+	return 63 - __builtin_clzll(x);
+#endif
+}
+
+//counts of latencies in nanoseconds, in buckets 1/32 of a power of two
+//wide as in HdrHistogram, so any percentile read back is within about 3%
+//of the true value while recording is an increment
+class latency_histogram
+{
+private:
+	static const int SUB_BITS = 5;
+	static const int SUB = 1 << SUB_BITS;
+	static const int BUCKETS = SUB + (64 - SUB_BITS) * SUB;
+
+	std::vector<uint64_t> counts;
+	uint64_t total = 0;
+	uint64_t highest = 0;
+
+	static int bucket(uint64_t ns) {
+		if (ns < SUB) return (int)ns;
+		int shift = msb64(ns) - SUB_BITS;
+		return SUB + shift * SUB + (int)((ns >> shift) - SUB);
+	}
+
+	//the largest latency that falls in a bucket
+	static uint64_t top(int b) {
+		if (b < SUB) return (uint64_t)b;
+		int shift = (b - SUB) / SUB;
+		uint64_t first = (uint64_t)(SUB + (b - SUB) % SUB) << shift;
+		return first + ((uint64_t)1 << shift) - 1;
+	}
+
+public:
+	latency_histogram() : counts(BUCKETS, 0) {}
+
+	void record(uint64_t ns) {
+		counts[bucket(ns)]++;
+		total++;
+		if (ns > highest) highest = ns;
+	}
+
+	void merge(const latency_histogram& other) {
+		for (int b = 0; b < BUCKETS; b++) counts[b] += other.counts[b];
+		total += other.total;
+		if (other.highest > highest) highest = other.highest;
+	}
+
+	uint64_t count() const { return total; }
+
+	uint64_t max() const { return highest; }
+
+	//latency at or below which a share p of the recorded ones fall
+	uint64_t percentile(double p) const {
+		if (total == 0) return 0;
+		uint64_t wanted = (uint64_t)(p * (double)total + 0.5);
+		if (wanted < 1) wanted = 1;
+		uint64_t seen = 0;
+		for (int b = 0; b < BUCKETS; b++)
+		{
+			seen += counts[b];
+			if (seen >= wanted) return std::min(top(b), highest);
+		}
+		return highest;
+	}
+};
+
+struct load_options
+{
+	int buses = 10000;
+	int threads = 4;
+	long operations = 50000; //per thread
+	//share of each operation in percent, in load_op order
+	int mix[LOAD_OPS] = { 30, 20, 10, 25, 15 };
+	int hot = 0; //percent of the operations that go to bus 0 and its route
+	int stopping = 25; //percent of the buses that stop twice on the way
+};
+
+struct load_op_result
+{
+	long missed = 0; //searches that found nothing, seats that were taken, nothing to cancel
+	latency_histogram latency;
+};
+
+struct load_result
+{
+	long operations = 0;
+	double seconds = 0;
+	load_op_result ops[LOAD_OPS];
+	long double_booked = 0; //segments of a seat held by two passengers
+	long unnamed = 0;       //seat segments reserved with no passenger, or the other way round
+	long passengers = 0;    //passengers left in the fleet
+	long expected = 0;      //seats booked less seats cancelled
+};
+
+//bus number of the n-th bus of a load test, n below 100000000 so that it
+//fits in BUS_NUMBER_SIZE
+inline void load_bus_number(int n, char* out, size_t size) {
+	snprintf(out, size, "L%u", (unsigned)n % 100000000u);
+}
+
+class load_test
+{
+private:
+	//seats this thread holds on one bus
+	struct held
+	{
+		int bus;
+		uint32_t seats;
+		int from;
+	};
+
+	struct worker_stats
+	{
+		load_op_result ops[LOAD_OPS];
+		std::vector<held> bookings;
+		long booked = 0;
+		long cancelled = 0;
+	};
+
+	fleet_store& fleet;
+	booking_engine& engine;
+	int routes;
+
+	//places at the ends of a route; there are fewer than 10000000 routes
+	static void route_names(int route, char* from, char* to) {
+		snprintf(from, NAME_SIZE, "P%u", (unsigned)route % 10000000u);
+		snprintf(to, NAME_SIZE, "Q%u", (unsigned)route % 10000000u);
+	}
+
+	int pick_bus(const load_options& opt, std::mt19937_64& rng) const {
+		if ((int)(rng() % 100) < opt.hot) return 0;
+		return (int)(rng() % (uint64_t)opt.buses);
+	}
+
+	//a random part of the route of a bus
+	void pick_leg(int bus, std::mt19937_64& rng, int& from, int& to) const {
+		int stops = fleet.stops(bus);
+		from = (int)(rng() % (uint64_t)(stops - 1));
+		to = from + 1 + (int)(rng() % (uint64_t)(stops - 1 - from));
+	}
+
+	//one operation, false when it had nothing to do or lost its seats
+	bool run_op(int op, const load_options& opt, std::mt19937_64& rng, const char* name, worker_stats& out) {
+		if (op == LOAD_SEARCH)
+		{
+			char from[NAME_SIZE], to[NAME_SIZE];
+			int route = (int)(rng() % 100) < opt.hot ? 0 : (int)(rng() % (uint64_t)routes);
+			route_names(route, from, to);
+			int earliest = (int)(rng() % (MINUTES_PER_DAY - 120));
+			return !engine.search(from, to, earliest, earliest + 120, 1).empty();
+		}
+		if (op == LOAD_CANCEL)
+		{
+			if (out.bookings.empty()) return false;
+			size_t i = (size_t)(rng() % out.bookings.size());
+			held h = out.bookings[i];
+			out.bookings[i] = out.bookings.back();
+			out.bookings.pop_back();
+			bool all = true;
+			for (uint32_t s = h.seats; s != 0; s &= s - 1)
+			{
+				if (engine.cancel(h.bus, ctz32(s) + 1, h.from) == BOOK_OK) out.cancelled++;
+				else all = false;
+			}
+			return all;
+		}
+
+		int bus = pick_bus(opt, rng);
+		if (op == LOAD_SHOW)
+		{
+			trip_info t;
+			if (!engine.trip(bus, t)) return false;
+			int stops = fleet.stops(bus);
+			int named = 0;
+			for (uint32_t taken = engine.seats(bus).mask(); taken != 0; taken &= taken - 1)
+			{
+				for (int from = 0; from < stops - 1; from++)
+				{
+					if (fleet.passenger(bus, ctz32(taken) + 1, from).name[0] != '\0') named++;
+				}
+			}
+			return named > 0;
+		}
+
+		int from, to;
+		pick_leg(bus, rng, from, to);
+		uint32_t seats;
+		if (op == LOAD_HOLD)
+		{
+			int n = 2 + (int)(rng() % 3), first;
+			if (engine.book_adjacent(bus, n, name, first, from, to) != BOOK_OK) return false;
+			seats = seat_map::run(first, n);
+		}
+		else
+		{
+			//a seat free when the passenger looked, which someone else may
+			//have taken since
+			uint32_t free = engine.seats(bus, from, to).free_mask();
+			if (free == 0) return false;
+			int skip = (int)(rng() % (uint64_t)popcount32(free));
+			while (skip-- > 0) free &= free - 1;
+			int seat = ctz32(free) + 1;
+			if (engine.book(bus, seat, name, from, to) != BOOK_OK) return false;
+			seats = seat_map::bit(seat);
+		}
+		out.bookings.push_back({ bus, seats, from });
+		out.booked += popcount32(seats);
+		return true;
+	}
+
+	void work(const load_options& opt, unsigned seed, worker_stats& out) {
+		std::mt19937_64 rng(seed);
+		std::uniform_int_distribution<int> percent(0, 99);
+		char name[NAME_SIZE];
+		snprintf(name, sizeof(name), "T%u", seed % 10000);
+		for (long i = 0; i < opt.operations; i++)
+		{
+			int pick = percent(rng), op = 0;
+			while (op < LOAD_OPS - 1 && pick >= opt.mix[op]) pick -= opt.mix[op++];
+			auto began = std::chrono::steady_clock::now();
+			bool hit = run_op(op, opt, rng, name, out);
+			out.ops[op].latency.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - began).count());
+			if (!hit) out.ops[op].missed++;
+		}
+	}
+
+	//go over every seat of every bus, see the top of the file
+	void check(load_result& result) const {
+		for (int bus = 0; bus < fleet.size(); bus++)
+		{
+			int stops = fleet.stops(bus);
+			std::vector<uint32_t> covered(stops - 1, 0);
+			for (int seat = 1; seat <= SEATS; seat++)
+			{
+				uint32_t bit = seat_map::bit(seat);
+				for (int from = 0; from < stops - 1; from++)
+				{
+					passenger_name p = fleet.passenger(bus, seat, from);
+					if (p.name[0] == '\0') continue;
+					result.passengers++;
+					for (int k = from; k < p.to; k++)
+					{
+						if (covered[k] & bit) result.double_booked++;
+						covered[k] |= bit;
+					}
+				}
+			}
+			for (int k = 0; k < stops - 1; k++) result.unnamed += popcount32(covered[k] ^ fleet.segment_mask(bus, k));
+		}
+	}
+
+public:
+	load_test(fleet_store& f, booking_engine& e) : fleet(f), engine(e), routes(1) {}
+
+	//install opt.buses buses numbered by load_bus_number into the engine,
+	//which should be empty. 50 buses share a route, leaving through the day
+	bool build(const load_options& opt) {
+		routes = std::max(1, opt.buses / 50);
+		fleet.reserve(opt.buses);
+		std::vector<std::string> none, two;
+		two.push_back("S1");
+		two.push_back("S2");
+		for (int bus = 0; bus < opt.buses; bus++)
+		{
+			trip_info t;
+			memset(&t, 0, sizeof(t));
+			load_bus_number(bus, t.busn, sizeof(t.busn));
+			strcpy(t.driver, "Load");
+			int depart = (int)((long)bus * 37 % MINUTES_PER_DAY);
+			snprintf(t.depart, sizeof(t.depart), "%02d:%02d", depart / 60, depart % 60);
+			strcpy(t.arrival, t.depart);
+			route_names(bus % routes, t.from, t.to);
+			if (engine.install(t, bus % 100 < opt.stopping ? two : none) != bus) return false;
+		}
+		return true;
+	}
+
+	//false when the mix does not add up to 100 or no fleet was built
+	bool run(const load_options& opt, load_result& result) {
+		int total = 0;
+		for (int op = 0; op < LOAD_OPS; op++)
+		{
+			if (opt.mix[op] < 0) return false;
+			total += opt.mix[op];
+		}
+		if (total != 100 || fleet.size() < opt.buses || opt.buses < 1) return false;
+
+		result = load_result();
+		std::vector<worker_stats> stats(opt.threads);
+		std::vector<std::thread> workers;
+		auto began = std::chrono::steady_clock::now();
+		for (int t = 0; t < opt.threads; t++)
+			workers.emplace_back(&load_test::work, this, std::cref(opt), 1000u + t, std::ref(stats[t]));
+		for (auto& w : workers) w.join();
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+
+		for (auto& s : stats)
+		{
+			for (int op = 0; op < LOAD_OPS; op++)
+			{
+				result.ops[op].latency.merge(s.ops[op].latency);
+				result.ops[op].missed += s.ops[op].missed;
+			}
+			result.expected += s.booked - s.cancelled;
+		}
+		for (int op = 0; op < LOAD_OPS; op++) result.operations += (long)result.ops[op].latency.count();
+		check(result);
+		return true;
+	}
+};
+
+#endif //BUS_LOADTEST_H
@@ -0,0 +1,375 @@
+//the reservation system without the menu: commands come one per line from a
+//file, stdin or a unix socket, and every command gets one line back, a JSON
+//object with "ok" true and the result or "ok" false and an "error". the
+//input is read in whatever blocks it arrives in, every whole line in a block
+//is run in order and the replies to all of them go out in one write, so a
+//client can send many commands without waiting for each reply.
+//
+//	install <bus no> <driver> <arrival> <departure> <from> <to> [stop...]
+//	reserve <bus no> <seat> <name> [<boarding> <leaving>]
+//	cancel <bus no> <seat> [<boarding>]
+//	show <bus no>
+//	avail
+//	search <from> <to> <earliest> <latest> <seats>
+//	sync
+//
+//stops and places are names, times are HH:MM. every client of the socket
+//gets a thread of its own, see bookingEngine.h for what may run at once
+
+#ifndef BUS_REQUESTSERVER_H
+#define BUS_REQUESTSERVER_H
+
+#include "bookingEngine.h"
+#include "fleetStore.h"
+#include "routeIndex.h"
+#include "seatMap.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+class request_processor
+{
+private:
+	fleet_store& fleet;
+	booking_engine& engine;
+
+	//s as a JSON string
+	static void quote(std::string& out, const char* s) {
+		out += '"';
+		for (; *s != '\0'; s++)
+		{
+			unsigned char c = (unsigned char)*s;
+			if (c == '"' || c == '\\')
+			{
+				out += '\\';
+				out += (char)c;
+			}
+			else if (c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out += escaped;
+			}
+			else out += (char)c;
+		}
+		out += '"';
+	}
+
+	static void field(std::string& out, const char* key, const char* value) {
+		out += ",\"";
+		out += key;
+		out += "\":";
+		quote(out, value);
+	}
+
+	static void field(std::string& out, const char* key, long value) {
+		out += ",\"";
+		out += key;
+		out += "\":";
+		out += std::to_string(value);
+	}
+
+	static void fail(std::string& out, const char* error) {
+		out += "{\"ok\":false";
+		field(out, "error", error);
+		out += "}\n";
+	}
+
+	//a word of a command into a field of 'size' bytes, false if it does not fit
+	static bool copy(char* to, const std::string& word, size_t size) {
+		if (word.size() >= size) return false;
+		memcpy(to, word.c_str(), word.size() + 1);
+		return true;
+	}
+
+	static bool number(const std::string& word, int& value) {
+		char* end;
+		long n = strtol(word.c_str(), &end, 10);
+		if (word.empty() || *end != '\0' || n < -1000000000L || n > 1000000000L) return false;
+		value = (int)n;
+		return true;
+	}
+
+	//name of a stop of a bus whose trip is 't'. the trip details are copied
+	//out, as installs may move them
+	const char* stop_name(int bus, const trip_info& t, int stops, int i) const {
+		if (i == 0) return t.from;
+		if (i == stops - 1) return t.to;
+		return fleet.stop(bus, i);
+	}
+
+	void install(const std::vector<std::string>& w, std::string& out) {
+		trip_info t;
+		memset(&t, 0, sizeof(t));
+		int minutes;
+		if (w.size() < 7 || !copy(t.busn, w[1], sizeof(t.busn)) || !copy(t.driver, w[2], sizeof(t.driver))
+			|| !copy(t.arrival, w[3], sizeof(t.arrival)) || !copy(t.depart, w[4], sizeof(t.depart))
+			|| !copy(t.from, w[5], sizeof(t.from)) || !copy(t.to, w[6], sizeof(t.to)))
+			return fail(out, "install <bus no> <driver> <arrival> <departure> <from> <to> [stop...]");
+		if (!parse_time(t.depart, minutes)) return fail(out, "Enter the departure time as HH:MM.");
+		if (w.size() - 7 > (size_t)MAX_STOPS - 2) return fail(out, "Too many stops on the way.");
+		std::vector<std::string> stops;
+		for (size_t i = 7; i < w.size(); i++)
+		{
+			if (w[i].size() >= NAME_SIZE) return fail(out, "A stop name is too long.");
+			stops.push_back(w[i]);
+		}
+		int bus = engine.install(t, stops);
+		if (bus == -2) return fail(out, book_message(BOOK_NOT_SAVED));
+		if (bus < 0) return fail(out, "This bus no. is already installed.");
+		out += "{\"ok\":true";
+		field(out, "bus", t.busn);
+		out += "}\n";
+	}
+
+	void reserve(const std::vector<std::string>& w, std::string& out) {
+		int seat;
+		if ((w.size() != 4 && w.size() != 6) || !number(w[2], seat))
+			return fail(out, "reserve <bus no> <seat> <name> [<boarding> <leaving>]");
+		int bus = engine.find(w[1].c_str());
+		if (bus < 0) return fail(out, book_message(BOOK_NO_BUS));
+		int from = 0, to = -1;
+		if (w.size() == 6)
+		{
+			from = engine.find_stop(bus, w[4].c_str());
+			to = engine.find_stop(bus, w[5].c_str());
+			if (from < 0 || to <= from) return fail(out, "The bus does not go between these stops.");
+		}
+		book_status status = engine.book(bus, seat, w[3].c_str(), from, to);
+		if (status != BOOK_OK) return fail(out, book_message(status));
+		out += "{\"ok\":true";
+		field(out, "bus", w[1].c_str());
+		field(out, "seat", seat);
+		out += "}\n";
+	}
+
+	void cancel(const std::vector<std::string>& w, std::string& out) {
+		int seat;
+		if ((w.size() != 3 && w.size() != 4) || !number(w[2], seat)) return fail(out, "cancel <bus no> <seat> [<boarding>]");
+		int bus = engine.find(w[1].c_str());
+		if (bus < 0) return fail(out, book_message(BOOK_NO_BUS));
+		int from = w.size() == 4 ? engine.find_stop(bus, w[3].c_str()) : 0;
+		if (from < 0) return fail(out, "The bus does not stop there.");
+		book_status status = engine.cancel(bus, seat, from);
+		if (status != BOOK_OK) return fail(out, book_message(status));
+		out += "{\"ok\":true";
+		field(out, "bus", w[1].c_str());
+		field(out, "seat", seat);
+		out += "}\n";
+	}
+
+	void show(const std::vector<std::string>& w, std::string& out) {
+		if (w.size() != 2) return fail(out, "show <bus no>");
+		int bus = engine.find(w[1].c_str());
+		trip_info t;
+		if (bus < 0 || !engine.trip(bus, t)) return fail(out, book_message(BOOK_NO_BUS));
+		int stops = fleet.stops(bus);
+		seat_map seats = engine.seats(bus);
+		out += "{\"ok\":true";
+		field(out, "bus", t.busn);
+		field(out, "driver", t.driver);
+		field(out, "arrival", t.arrival);
+		field(out, "departure", t.depart);
+		field(out, "from", t.from);
+		field(out, "to", t.to);
+		field(out, "free", seats.free_count());
+		out += ",\"stops\":[";
+		for (int i = 0; i < stops; i++)
+		{
+			if (i > 0) out += ',';
+			quote(out, stop_name(bus, t, stops, i));
+		}
+		out += "],\"reserved\":[";
+		bool first = true;
+		for (uint32_t taken = seats.mask(); taken != 0; taken &= taken - 1)
+		{
+			int s = ctz32(taken) + 1;
+			for (int from = 0; from < stops - 1; from++)
+			{
+				passenger_name p = fleet.passenger(bus, s, from);
+				if (p.name[0] == '\0') continue;
+				out += first ? "{" : ",{";
+				first = false;
+				out += "\"seat\":" + std::to_string(s);
+				field(out, "name", p.name);
+				field(out, "from", stop_name(bus, t, stops, from));
+				field(out, "to", stop_name(bus, t, stops, p.to));
+				out += '}';
+			}
+		}
+		out += "]}\n";
+	}
+
+	void avail(std::string& out) {
+		out += "{\"ok\":true,\"buses\":[";
+		int n = fleet.size();
+		for (int bus = 0; bus < n; bus++)
+		{
+			trip_info t;
+			if (!engine.trip(bus, t)) continue;
+			out += bus > 0 ? ",{" : "{";
+			out += "\"bus\":";
+			quote(out, t.busn);
+			field(out, "driver", t.driver);
+			field(out, "arrival", t.arrival);
+			field(out, "departure", t.depart);
+			field(out, "from", t.from);
+			field(out, "to", t.to);
+			field(out, "free", engine.seats(bus).free_count());
+			out += '}';
+		}
+		out += "]}\n";
+	}
+
+	void search(const std::vector<std::string>& w, std::string& out) {
+		int first, last, seats;
+		if (w.size() != 6 || !number(w[5], seats)) return fail(out, "search <from> <to> <earliest> <latest> <seats>");
+		if (!parse_time(w[3].c_str(), first) || !parse_time(w[4].c_str(), last)) return fail(out, "Enter the times as HH:MM.");
+		std::vector<trip_match> found = engine.search(w[1].c_str(), w[2].c_str(), first, last, seats);
+		out += "{\"ok\":true,\"buses\":[";
+		bool none = true;
+		for (const trip_match& m : found)
+		{
+			trip_info t;
+			if (!engine.trip(m.bus, t)) continue;
+			out += none ? "{" : ",{";
+			none = false;
+			out += "\"bus\":";
+			quote(out, t.busn);
+			field(out, "departure", t.depart);
+			field(out, "arrival", t.arrival);
+			field(out, "free", m.free);
+			out += '}';
+		}
+		out += "]}\n";
+	}
+
+public:
+	request_processor(fleet_store& f, booking_engine& e) : fleet(f), engine(e) {}
+
+	//run one command line and add its reply to 'out'. blank lines get none
+	void run(const char* line, std::string& out) {
+		std::vector<std::string> w;
+		for (const char* c = line; *c != '\0';)
+		{
+			while (*c == ' ' || *c == '\t' || *c == '\r') c++;
+			const char* start = c;
+			while (*c != '\0' && *c != ' ' && *c != '\t' && *c != '\r') c++;
+			if (c > start) w.push_back(std::string(start, c));
+		}
+		if (w.empty()) return;
+		const std::string& op = w[0];
+		if (op == "install") install(w, out);
+		else if (op == "reserve") reserve(w, out);
+		else if (op == "cancel") cancel(w, out);
+		else if (op == "show") show(w, out);
+		else if (op == "avail") avail(out);
+		else if (op == "search") search(w, out);
+		else if (op == "sync")
+		{
+			if (engine.sync()) out += "{\"ok\":true}\n";
+			else fail(out, "The journal could not be written.");
+		}
+		else fail(out, "Unknown command.");
+	}
+
+	//run the commands read from 'in' and write their replies to 'out' until
+	//the input ends, false if writing fails
+	bool serve(int in, int out) {
+		std::vector<char> pending;
+		std::string replies;
+		char block[1 << 16];
+		while (true)
+		{
+#ifdef _WIN32
+			int got = _read(in, block, sizeof(block));
+#else
+			long got = read(in, block, sizeof(block));
+#endif
+			if (got <= 0) break;
+			pending.insert(pending.end(), block, block + got);
+			size_t start = 0;
+			for (size_t i = 0; i < pending.size(); i++)
+			{
+				if (pending[i] != '\n') continue;
+				pending[i] = '\0';
+				run(&pending[start], replies);
+				start = i + 1;
+			}
+			pending.erase(pending.begin(), pending.begin() + start);
+			if (!write_all(out, replies)) return false;
+			replies.clear();
+		}
+		//a last line without a newline
+		pending.push_back('\0');
+		run(pending.data(), replies);
+		return write_all(out, replies);
+	}
+
+	static bool write_all(int out, const std::string& data) {
+		for (size_t done = 0; done < data.size();)
+		{
+#ifdef _WIN32
+			int wrote = _write(out, data.data() + done, (unsigned)(data.size() - done));
+#else
+			long wrote = write(out, data.data() + done, data.size() - done);
+#endif
+			if (wrote <= 0) return false;
+			done += (size_t)wrote;
+		}
+		return true;
+	}
+
+#ifndef _WIN32
+	//take clients on a unix socket at 'path', each on a thread of its own,
+	//until accepting fails. a socket left at 'path' by an earlier run is
+	//replaced. false if the socket can not be made or something else is
+	//at 'path'
+	bool serve_socket(const char* path) {
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (strlen(path) >= sizeof(address.sun_path)) return false;
+		strcpy(address.sun_path, path);
+		//a client that goes away mid reply is an error on write, not the end
+		//of the program
+		signal(SIGPIPE, SIG_IGN);
+		struct stat existing;
+		if (lstat(path, &existing) == 0 && (!S_ISSOCK(existing.st_mode) || unlink(path) != 0)) return false;
+		int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listener < 0) return false;
+		if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0)
+		{
+			::close(listener);
+			return false;
+		}
+		while (true)
+		{
+			int client = accept(listener, nullptr, nullptr);
+			if (client < 0) break;
+			std::thread([this, client] {
+				serve(client, client);
+				::close(client);
+				}).detach();
+		}
+		::close(listener);
+		return true;
+	}
+#endif
+};
+
+#endif //BUS_REQUESTSERVER_H
@@ -0,0 +1,344 @@
+//append-only journal of the changes made to the fleet, so they survive the
+//program. every entry is a type, a sequence number and the bytes of the
+//change, with a checksum over them; entries are gathered in memory and
+//written and fsynced in batches, see journal_options. an entry cut short by
+//a crash fails its checksum and it and whatever follows it are dropped when
+//the journal is opened again.
+//
+//a batch that fails to be written is cut off the file again and kept to be
+//tried with the next one. from then on the journal takes no new entries and
+//sync() keeps returning false, as the changes it refuses can not be kept.
+//
+//the journal only needs what came after the last snapshot of the fleet,
+//see fleetSnapshot.h, and compact() drops the entries a snapshot holds
+
+#ifndef BUS_RESERVATIONJOURNAL_H
+#define BUS_RESERVATIONJOURNAL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+//checksum of a run of bytes, FNV-1a; pass the last result as 'h' to go on
+inline uint32_t fnv32(const void* data, size_t size, uint32_t h = 2166136261u) {
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+//write out what stdio holds of a file and wait for it to reach the disk
+inline bool sync_file(FILE* f) {
+	if (fflush(f) != 0) return false;
+#ifdef _WIN32
+	return _commit(_fileno(f)) == 0;
+#else
+	return fsync(fileno(f)) == 0;
+#endif
+}
+
+//cut a file to its first 'size' bytes
+inline bool truncate_file(FILE* f, long size) {
+	if (fflush(f) != 0) return false;
+#ifdef _WIN32
+	return _chsize(_fileno(f), size) == 0;
+#else
+	return ftruncate(fileno(f), size) == 0;
+#endif
+}
+
+//put a new file in place of an old one. atomic on POSIX; windows can not
+//rename over a file, so there is a moment with neither
+inline bool replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+	remove(to);
+#endif
+	return rename(from, to) == 0;
+}
+
+//how often the journal goes to the disk. an entry is safe once it is
+//fsynced, and at most sync_entries entries or sync_ms milliseconds of them
+//are lost in a crash. sync_entries of 1 syncs every entry before append()
+//returns
+struct journal_options
+{
+	int sync_entries = 256;
+	int sync_ms = 10;
+	long snapshot_entries = 100000; //entries after which a snapshot is due
+};
+
+class reservation_journal
+{
+private:
+	//what comes before the bytes of every entry in the file
+	struct entry_head
+	{
+		uint32_t size;
+		uint32_t check; //fnv32 of seq, type and the bytes
+		uint64_t seq;
+		uint8_t type;
+		uint8_t pad[7];
+	};
+
+	FILE* file = nullptr; //swapped by compact() under 'io'
+	long written = 0;     //bytes of whole entries in the file, under 'io'
+	std::atomic<bool> opened{ false };
+	std::string path;
+	journal_options options;
+
+	std::mutex lock; //the fields below
+	std::condition_variable waiting;
+	std::vector<char> buffer; //entries not written yet
+	int buffered = 0;
+	uint64_t seq = 0;
+	long entries = 0; //entries in the file and the buffer
+	bool stopping = false;
+	bool failed = false;
+
+	std::mutex io; //writing the file, taken before 'lock'
+	std::thread syncer;
+
+	static uint32_t check_of(const entry_head& h, const void* data) {
+		uint32_t c = fnv32(&h.seq, sizeof(h.seq));
+		c = fnv32(&h.type, sizeof(h.type), c);
+		return fnv32(data, h.size, c);
+	}
+
+	//read the next entry of a file into 'head' and 'data', false at the end
+	//of the file or at an entry that is cut short or damaged
+	static bool read_entry(FILE* f, entry_head& head, std::vector<char>& data) {
+		if (fread(&head, sizeof(head), 1, f) != 1) return false;
+		if (head.size > (1u << 20)) return false;
+		data.resize(head.size);
+		if (head.size != 0 && fread(data.data(), head.size, 1, f) != 1) return false;
+		return check_of(head, data.data()) == head.check;
+	}
+
+	//write and fsync what is buffered, with 'io' held. a batch that fails is
+	//cut off the file and put back in front of the buffer
+	bool flush_locked() {
+		std::vector<char> out;
+		int count;
+		bool good;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			out.swap(buffer);
+			count = buffered;
+			buffered = 0;
+			good = !failed;
+		}
+		if (out.empty()) return good;
+		if (file != nullptr && fwrite(out.data(), 1, out.size(), file) == out.size() && sync_file(file))
+		{
+			written += (long)out.size();
+			return good;
+		}
+
+		//part of the batch may be in the file, and more of it in what stdio
+		//holds, so the file is opened again and cut back to its whole entries
+		if (file != nullptr) fclose(file);
+		file = fopen(path.c_str(), "ab");
+		if (file != nullptr && !truncate_file(file, written))
+		{
+			fclose(file);
+			file = nullptr;
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		out.insert(out.end(), buffer.begin(), buffer.end());
+		buffer.swap(out);
+		buffered += count;
+		failed = true;
+		return false;
+	}
+
+	void sync_loop() {
+		std::unique_lock<std::mutex> held(lock);
+		while (!stopping)
+		{
+			waiting.wait_for(held, std::chrono::milliseconds(options.sync_ms > 0 ? options.sync_ms : 1));
+			if (buffered == 0) continue;
+			held.unlock();
+			{
+				std::lock_guard<std::mutex> writing(io);
+				flush_locked();
+			}
+			held.lock();
+		}
+	}
+
+public:
+	reservation_journal() {}
+	reservation_journal(const reservation_journal&) = delete;
+	reservation_journal& operator=(const reservation_journal&) = delete;
+
+	~reservation_journal() { close(); }
+
+	//open or create the journal at 'path' and call visit(seq, type, data,
+	//size) for each of its entries after sequence number 'after', oldest
+	//first. a damaged tail is cut off. false if the file can not be opened
+	template <class F>
+	bool open(const char* p, uint64_t after, F visit, const journal_options& o = journal_options()) {
+		close();
+		path = p;
+		options = o;
+		seq = after;
+		entries = 0;
+		failed = false;
+		long good = 0;
+		if (FILE* f = fopen(p, "rb"))
+		{
+			entry_head head;
+			std::vector<char> data;
+			while (read_entry(f, head, data))
+			{
+				good += (long)(sizeof(head) + head.size);
+				entries++;
+				if (head.seq > seq) seq = head.seq;
+				if (head.seq > after) visit(head.seq, (int)head.type, data.data(), (size_t)head.size);
+			}
+			fclose(f);
+		}
+		file = fopen(p, "ab");
+		written = good;
+		if (file == nullptr || !truncate_file(file, good))
+		{
+			close();
+			return false;
+		}
+		stopping = false;
+		opened.store(true, std::memory_order_release);
+		if (options.sync_entries > 1) syncer = std::thread(&reservation_journal::sync_loop, this);
+		return true;
+	}
+
+	bool is_open() const { return opened.load(std::memory_order_acquire); }
+
+	//write out whatever is left and close the file
+	void close() {
+		opened.store(false, std::memory_order_release);
+		if (syncer.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			waiting.notify_all();
+			syncer.join();
+		}
+		if (file != nullptr)
+		{
+			{
+				std::lock_guard<std::mutex> writing(io);
+				flush_locked();
+			}
+			fclose(file);
+			file = nullptr;
+		}
+	}
+
+	//add an entry, returns its sequence number. it reaches the disk as
+	//journal_options says, or at sync(). 0 without adding it once the
+	//journal has failed to be written
+	uint64_t append(int type, const void* data, size_t size) {
+		entry_head head;
+		memset(&head, 0, sizeof(head));
+		head.size = (uint32_t)size;
+		head.type = (uint8_t)type;
+		bool full;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (failed) return 0;
+			head.seq = ++seq;
+			head.check = check_of(head, data);
+			const char* h = (const char*)&head;
+			buffer.insert(buffer.end(), h, h + sizeof(head));
+			buffer.insert(buffer.end(), (const char*)data, (const char*)data + size);
+			entries++;
+			full = ++buffered >= options.sync_entries;
+		}
+		if (full) sync();
+		return head.seq;
+	}
+
+	//write and fsync every entry added so far, false if the journal could
+	//not be written, now or before
+	bool sync() {
+		std::lock_guard<std::mutex> writing(io);
+		return flush_locked();
+	}
+
+	//false once the journal has failed to be written and takes no entries
+	bool good() {
+		std::lock_guard<std::mutex> guard(lock);
+		return !failed;
+	}
+
+	//sequence number of the last entry
+	uint64_t last_seq() {
+		std::lock_guard<std::mutex> guard(lock);
+		return seq;
+	}
+
+	//entries in the journal, the ones a snapshot holds included
+	long size() {
+		std::lock_guard<std::mutex> guard(lock);
+		return entries;
+	}
+
+	//a snapshot is due once snapshot_entries entries follow the first 'after'
+	bool snapshot_due(long after = 0) { return size() >= after + options.snapshot_entries; }
+
+	//drop the entries up to sequence number 'upto', which a snapshot holds
+	//now. the rest is copied to a new file that then takes the place of the
+	//journal; entries keep being added meanwhile
+	bool compact(uint64_t upto) {
+		std::lock_guard<std::mutex> writing(io);
+		if (!flush_locked()) return false;
+		std::string temp = path + ".tmp";
+		FILE* in = fopen(path.c_str(), "rb");
+		FILE* out = fopen(temp.c_str(), "wb");
+		bool ok = in != nullptr && out != nullptr;
+		long kept = 0;
+		long bytes = 0;
+		entry_head head;
+		std::vector<char> data;
+		while (ok && read_entry(in, head, data))
+		{
+			if (head.seq <= upto) continue;
+			ok = fwrite(&head, sizeof(head), 1, out) == 1 && (head.size == 0 || fwrite(data.data(), head.size, 1, out) == 1);
+			kept++;
+			bytes += (long)(sizeof(head) + head.size);
+		}
+		if (in != nullptr) fclose(in);
+		ok = ok && sync_file(out);
+		if (out != nullptr) fclose(out);
+		if (!ok)
+		{
+			remove(temp.c_str());
+			return false;
+		}
+		fclose(file);
+		ok = replace_file(temp.c_str(), path.c_str());
+		file = fopen(path.c_str(), "ab");
+		if (ok) written = bytes;
+		std::lock_guard<std::mutex> guard(lock);
+		if (file == nullptr) failed = true;
+		if (!ok || file == nullptr) return false;
+		entries = kept + buffered;
+		return true;
+	}
+};
+
+#endif //BUS_RESERVATIONJOURNAL_H
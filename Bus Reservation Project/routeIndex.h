@@ -0,0 +1,87 @@
+//index of the buses by route and departure time. every from/to pair has its
+//own list of (departure, bus) kept sorted by departure, so the buses of a
+//route leaving within a time window are one hash lookup and a binary search
+//away, O(log n + k) for k buses in the window. places are matched without
+//regard to case
+
+#ifndef BUS_ROUTEINDEX_H
+#define BUS_ROUTEINDEX_H
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+const int MINUTES_PER_DAY = 24 * 60;
+
+//minutes after midnight of a time written as HH:MM, HHMM or HH, false when
+//it is none of those or not a time of day
+inline bool parse_time(const char* text, int& minutes) {
+	int value = 0, digits = 0, before = -1; //digits before the colon, -1 without one
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		if (*c == ':' && before < 0) before = digits;
+		else if (isdigit((unsigned char)*c) && digits < 4)
+		{
+			value = value * 10 + (*c - '0');
+			digits++;
+		}
+		else return false;
+	}
+	int hours, mins;
+	if (before >= 0 ? (before == 1 || before == 2) && digits - before == 2 : digits == 4)
+	{
+		hours = value / 100;
+		mins = value % 100;
+	}
+	else if (before < 0 && (digits == 1 || digits == 2))
+	{
+		hours = value;
+		mins = 0;
+	}
+	else return false;
+	if (hours > 23 || mins > 59) return false;
+	minutes = hours * 60 + mins;
+	return true;
+}
+
+class route_index
+{
+private:
+	//departure in minutes and bus position, sorted
+	typedef std::vector<std::pair<int, int>> departures;
+
+	std::unordered_map<std::string, departures> routes;
+
+	static std::string key(const char* from, const char* to) {
+		std::string k;
+		for (const char* c = from; *c != '\0'; c++) k += (char)tolower((unsigned char)*c);
+		k += '\0';
+		for (const char* c = to; *c != '\0'; c++) k += (char)tolower((unsigned char)*c);
+		return k;
+	}
+
+public:
+	void clear() { routes.clear(); }
+
+	void insert(const char* from, const char* to, int depart, int bus) {
+		departures& d = routes[key(from, to)];
+		std::pair<int, int> e(depart, bus);
+		d.insert(std::upper_bound(d.begin(), d.end(), e), e);
+	}
+
+	//call visit(depart, bus) for every bus from 'from' to 'to' leaving
+	//between 'earliest' and 'latest' minutes, both included, earliest first
+	template <class F>
+	void find(const char* from, const char* to, int earliest, int latest, F visit) const {
+		auto it = routes.find(key(from, to));
+		if (it == routes.end()) return;
+		const departures& d = it->second;
+		for (auto e = std::lower_bound(d.begin(), d.end(), std::make_pair(earliest, -1)); e != d.end() && e->first <= latest; ++e)
+			visit(e->first, e->second);
+	}
+};
+
+#endif //BUS_ROUTEINDEX_H
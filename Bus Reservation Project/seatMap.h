@@ -0,0 +1,109 @@
+//availability of the seats of one bus as a bit mask, bit i standing for seat
+//number i + 1 and set while that seat is reserved. the passenger names are
+//kept elsewhere; counting the free seats, finding the first free one and
+//finding n free seats side by side in a row are each a few word operations
+//instead of a string compare per seat
+
+#ifndef BUS_SEATMAP_H
+#define BUS_SEATMAP_H
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+const int SEATS = 32;
+const int SEATS_PER_ROW = 4;
+const int ROWS = SEATS / SEATS_PER_ROW;
+
+//number of set bits
+inline int popcount32(uint32_t x) {
+#ifdef _MSC_VER
+	return (int)__popcnt(x);
+#else
+	return __builtin_popcount(x);
+#endif
+}
+
+//index of the lowest set bit, x may not be 0
+inline int ctz32(uint32_t x) {
+#ifdef _MSC_VER
+	unsigned long at;
+	_BitScanForward(&at, x);
+	return (int)at;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+//bit of every seat that can start a run of n seats without leaving its row,
+//0 when a row is too short for n
+inline uint32_t run_starts(int n) {
+	if (n < 1 || n > SEATS_PER_ROW) return 0;
+	uint32_t row = (1u << (SEATS_PER_ROW - n + 1)) - 1;
+	return row * 0x11111111u;
+}
+
+class seat_map
+{
+private:
+	uint32_t taken = 0;
+
+public:
+	seat_map() {}
+
+	//the map of a seat word read from elsewhere, see fleetStore.h
+	explicit seat_map(uint32_t reserved) : taken(reserved) {}
+
+	static bool valid(int seat) { return seat >= 1 && seat <= SEATS; }
+
+	static uint32_t bit(int seat) { return 1u << (seat - 1); }
+
+	//bits of n seats starting at 'first'
+	static uint32_t run(int first, int n) {
+		return (uint32_t)((((uint64_t)1 << n) - 1) << (first - 1));
+	}
+
+	//every seat free again
+	void clear() { taken = 0; }
+
+	//reserved seats, bit i for seat i + 1
+	uint32_t mask() const { return taken; }
+
+	//free seats, bit i for seat i + 1
+	uint32_t free_mask() const { return ~taken; }
+
+	bool is_free(int seat) const { return valid(seat) && (taken & bit(seat)) == 0; }
+
+	//mark a seat as reserved, false if it was taken already or does not exist
+	bool reserve(int seat) {
+		if (!is_free(seat)) return false;
+		taken |= bit(seat);
+		return true;
+	}
+
+	void release(int seat) {
+		if (valid(seat)) taken &= ~bit(seat);
+	}
+
+	int free_count() const { return SEATS - popcount32(taken); }
+
+	int reserved_count() const { return popcount32(taken); }
+
+	//lowest free seat number, 0 when the bus is full
+	int first_free() const {
+		uint32_t free = free_mask();
+		return free == 0 ? 0 : ctz32(free) + 1;
+	}
+
+	//first seat of the lowest run of n free seats next to each other in one
+	//row, 0 when there is none
+	int find_adjacent(int n) const {
+		uint32_t runs = free_mask() & run_starts(n);
+		for (int k = 1; k < n; k++) runs &= free_mask() >> k;
+		return runs == 0 ? 0 : ctz32(runs) + 1;
+	}
+};
+
+#endif //BUS_SEATMAP_H
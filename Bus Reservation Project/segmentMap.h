@@ -0,0 +1,106 @@
+//seat occupancy of a bus that stops on the way. the route is cut into
+//segments between neighbouring stops and every segment has its own mask of
+//reserved seats, bit i for seat i + 1, so a seat sold from the first stop
+//to the second can be sold again from the second stop on. the seats free
+//from one stop to another are the AND of the free masks of the segments in
+//between, one word operation per segment.
+//
+//claims and releases take the lock of the map, as they change several
+//words; availability is read without it and may see a claim half done
+
+#ifndef BUS_SEGMENTMAP_H
+#define BUS_SEGMENTMAP_H
+
+#include "seatMap.h"
+
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//stops of one route, its two ends included
+const int MAX_STOPS = 64;
+
+//true when two place names are the same but for case
+inline bool same_place(const char* a, const char* b) {
+	for (; *a != '\0' && *b != '\0'; a++, b++)
+	{
+		if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return false;
+	}
+	return *a == *b;
+}
+
+class segment_map
+{
+private:
+	std::vector<std::string> names;
+	std::unique_ptr<std::atomic<uint32_t>[]> legs; //segment k runs from stop k to stop k + 1
+	std::mutex lock;
+
+	//the free masks of stop 'from' to stop 'to' ANDed together
+	uint32_t free_between(int from, int to) const {
+		uint32_t free = ~0u;
+		for (int k = from; k < to; k++) free &= ~legs[k].load(std::memory_order_acquire);
+		return free;
+	}
+
+public:
+	//'stops' from the first stop to the last, at least 2 and at most MAX_STOPS
+	explicit segment_map(const std::vector<std::string>& stops) : names(stops), legs(new std::atomic<uint32_t>[stops.size() - 1]) {
+		for (int k = 0; k < segments(); k++) legs[k].store(0, std::memory_order_relaxed);
+	}
+
+	int stops() const { return (int)names.size(); }
+
+	int segments() const { return (int)names.size() - 1; }
+
+	const std::string& stop(int i) const { return names[i]; }
+
+	//position of a stop on the route, -1 if the bus does not stop there
+	int find_stop(const char* place) const {
+		for (int i = 0; i < stops(); i++)
+		{
+			if (same_place(names[i].c_str(), place)) return i;
+		}
+		return -1;
+	}
+
+	//seats reserved on any segment between two stops
+	seat_map seats(int from, int to) const { return seat_map(~free_between(from, to)); }
+
+	//reserve the seats in 'mask' from stop 'from' to stop 'to', false and
+	//nothing reserved if any of them is taken on the way
+	bool claim(uint32_t mask, int from, int to) {
+		std::lock_guard<std::mutex> guard(lock);
+		if ((~free_between(from, to) & mask) != 0) return false;
+		for (int k = from; k < to; k++) legs[k].fetch_or(mask, std::memory_order_acq_rel);
+		return true;
+	}
+
+	//reserve the lowest run of n seats side by side in a row that are free
+	//from stop 'from' to stop 'to', returns its first seat or 0
+	int claim_adjacent(int n, int from, int to) {
+		std::lock_guard<std::mutex> guard(lock);
+		int first = seat_map(~free_between(from, to)).find_adjacent(n);
+		if (first == 0) return 0;
+		for (int k = from; k < to; k++) legs[k].fetch_or(seat_map::run(first, n), std::memory_order_acq_rel);
+		return first;
+	}
+
+	//reserve the seats in 'mask' from stop 'from' to stop 'to' whether or not
+	//they are free, for rebuilding the map from a journal
+	void mark(uint32_t mask, int from, int to) {
+		std::lock_guard<std::mutex> guard(lock);
+		for (int k = from; k < to; k++) legs[k].fetch_or(mask, std::memory_order_acq_rel);
+	}
+
+	void release(uint32_t mask, int from, int to) {
+		std::lock_guard<std::mutex> guard(lock);
+		for (int k = from; k < to; k++) legs[k].fetch_and(~mask, std::memory_order_acq_rel);
+	}
+};
+
+#endif //BUS_SEGMENTMAP_H
@@ -0,0 +1,406 @@
+//benchmark of the linked list variants against std::list and std::deque.
+//for every element size and list length it times push/pop at both ends,
+//addAt/removeAt at random positions, indexOf scans, reverse and a full
+//iteration, and reports ns/op, heap bytes per element and cache misses
+//
+//usage: ListBenchmark [maxLength] [randomOps]
+//	maxLength	longest list to run, lengths go 10^3, 10^4, ... up to it (default 10^6)
+//	randomOps	addAt/removeAt calls per run (default 1000)
+
+#include "../Double Linked List/LinkedList.cpp"
+#include "../Compact Linked List/CompactLinkedList.h"
+#include "../Intrusive Linked List/IntrusiveLinkedList.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+//heap accounting: every allocation of the program goes through these so the
+//live bytes of a container can be read before and after filling it
+static size_t g_heapBytes = 0;
+static const size_t ALLOC_HEADER = 16; //keeps the returned block 16 byte aligned
+
+void* operator new(size_t bytes) {
+	char* block = (char*)malloc(bytes + ALLOC_HEADER);
+	if (block == nullptr) throw bad_alloc();
+	memcpy(block, &bytes, sizeof(bytes));
+	g_heapBytes += bytes;
+	return block + ALLOC_HEADER;
+}
+
+void operator delete(void* ptr) noexcept {
+	if (ptr == nullptr) return;
+	char* block = (char*)ptr - ALLOC_HEADER;
+	size_t bytes;
+	memcpy(&bytes, block, sizeof(bytes));
+	g_heapBytes -= bytes;
+	free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	operator delete(ptr);
+}
+
+//hardware cache miss counter, reads as unavailable when perf_event_open
+//is missing or not permitted
+class CacheMissCounter {
+public:
+	CacheMissCounter() {
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd_ = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	~CacheMissCounter() {
+#ifdef __linux__
+		if (fd_ >= 0) close(fd_);
+#endif
+	}
+
+	bool available() const {
+		return fd_ >= 0;
+	}
+
+	void start() {
+#ifdef __linux__
+		if (fd_ < 0) return;
+		ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+
+	//misses counted since start()
+	long long stop() {
+#ifdef __linux__
+		if (fd_ < 0) return -1;
+		ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+		long long count = 0;
+		if (read(fd_, &count, sizeof(count)) != (ssize_t)sizeof(count)) return -1;
+		return count;
+#else
+		return -1;
+#endif
+	}
+private:
+	int fd_ = -1;
+};
+
+//element of N bytes, the first four hold the key used for comparisons
+template <size_t N>
+struct Payload {
+	uint32_t key;
+	char pad[N - sizeof(uint32_t)];
+
+	Payload() :key(0) {}
+	Payload(uint32_t k) :key(k) {}
+	bool operator == (const Payload& other) const { return key == other.key; }
+};
+
+template <>
+struct Payload<4> {
+	uint32_t key;
+
+	Payload() :key(0) {}
+	Payload(uint32_t k) :key(k) {}
+	bool operator == (const Payload& other) const { return key == other.key; }
+};
+
+template <size_t N>
+ostream& operator << (ostream& strm, const Payload<N>& p) {
+	return strm << p.key;
+}
+
+//adapters giving every list the same small interface
+
+template <class T>
+struct DoublyAdapter {
+	static const char* name() { return "DoublyLinkedList"; }
+	dsa::DoublyLinkedList<T> list_;
+
+	void pushBack(const T& v) { list_.addLast(v); }
+	void pushFront(const T& v) { list_.addFirst(v); }
+	void popBack() { list_.removeLast(); }
+	void popFront() { list_.removeFirst(); }
+	void addAt(int i, const T& v) { list_.addAt(i, v); }
+	void removeAt(int i) { list_.removeAt(i); }
+	int indexOf(const T& v) { return list_.indexOf(v); }
+	void reverse() { list_.reverse(); }
+	uint64_t sum() {
+		uint64_t s = 0;
+		for (auto it = list_.begin(); it != list_.end(); ++it) s += (*it).key;
+		return s;
+	}
+};
+
+template <class T>
+struct CompactAdapter {
+	static const char* name() { return "CompactLinkedList"; }
+	dsa::CompactLinkedList<T> list_;
+
+	void pushBack(const T& v) { list_.addLast(v); }
+	void pushFront(const T& v) { list_.addFirst(v); }
+	void popBack() { list_.removeLast(); }
+	void popFront() { list_.removeFirst(); }
+	void addAt(int i, const T& v) { list_.addAt(i, v); }
+	void removeAt(int i) { list_.removeAt(i); }
+	int indexOf(const T& v) { return list_.indexOf(v); }
+	void reverse() { list_.reverse(); }
+	uint64_t sum() {
+		uint64_t s = 0;
+		for (auto it = list_.begin(); it != list_.end(); ++it) s += (*it).key;
+		return s;
+	}
+};
+
+//the intrusive list does not own storage, elements come from a pool of
+//objects allocated on demand the way a scheduler would allocate its tasks
+template <class T>
+struct IntrusiveAdapter {
+	struct Item {
+		T value_;
+		dsa::ListHook hook_;
+	};
+	static const char* name() { return "IntrusiveLinkedList"; }
+	dsa::IntrusiveLinkedList<Item, offsetof(Item, hook_)> list_;
+	deque<Item> pool_;
+	vector<Item*> free_;
+
+	Item& make_(const T& v) {
+		Item* item;
+		if (free_.empty()) {
+			pool_.emplace_back();
+			item = &pool_.back();
+		}
+		else {
+			item = free_.back();
+			free_.pop_back();
+		}
+		item->value_ = v;
+		return *item;
+	}
+	Item& at_(int i) {
+		auto it = list_.begin();
+		while (i-- > 0) ++it;
+		return *it;
+	}
+
+	void pushBack(const T& v) { list_.addLast(make_(v)); }
+	void pushFront(const T& v) { list_.addFirst(make_(v)); }
+	void popBack() { free_.push_back(&list_.removeLast()); }
+	void popFront() { free_.push_back(&list_.removeFirst()); }
+	void addAt(int i, const T& v) {
+		if (i == list_.size()) list_.addLast(make_(v));
+		else list_.addBefore(at_(i), make_(v));
+	}
+	void removeAt(int i) {
+		Item& item = at_(i);
+		list_.remove(item);
+		free_.push_back(&item);
+	}
+	int indexOf(const T& v) {
+		int i = 0;
+		for (auto it = list_.begin(); it != list_.end(); ++it, i++) if ((*it).value_ == v) return i;
+		return -1;
+	}
+	void reverse() { list_.reverse(); }
+	uint64_t sum() {
+		uint64_t s = 0;
+		for (auto it = list_.begin(); it != list_.end(); ++it) s += (*it).value_.key;
+		return s;
+	}
+};
+
+template <class T>
+struct StdListAdapter {
+	static const char* name() { return "std::list"; }
+	list<T> list_;
+
+	typename list<T>::iterator at_(int i) {
+		int n = (int)list_.size();
+		if (i < n / 2) return next(list_.begin(), i);
+		return prev(list_.end(), n - i);
+	}
+	void pushBack(const T& v) { list_.push_back(v); }
+	void pushFront(const T& v) { list_.push_front(v); }
+	void popBack() { list_.pop_back(); }
+	void popFront() { list_.pop_front(); }
+	void addAt(int i, const T& v) { list_.insert(at_(i), v); }
+	void removeAt(int i) { list_.erase(at_(i)); }
+	int indexOf(const T& v) {
+		int i = 0;
+		for (auto it = list_.begin(); it != list_.end(); ++it, i++) if (*it == v) return i;
+		return -1;
+	}
+	void reverse() { list_.reverse(); }
+	uint64_t sum() {
+		uint64_t s = 0;
+		for (const T& v : list_) s += v.key;
+		return s;
+	}
+};
+
+template <class T>
+struct StdDequeAdapter {
+	static const char* name() { return "std::deque"; }
+	deque<T> list_;
+
+	void pushBack(const T& v) { list_.push_back(v); }
+	void pushFront(const T& v) { list_.push_front(v); }
+	void popBack() { list_.pop_back(); }
+	void popFront() { list_.pop_front(); }
+	void addAt(int i, const T& v) { list_.insert(list_.begin() + i, v); }
+	void removeAt(int i) { list_.erase(list_.begin() + i); }
+	int indexOf(const T& v) {
+		auto it = find(list_.begin(), list_.end(), v);
+		return it == list_.end() ? -1 : (int)(it - list_.begin());
+	}
+	void reverse() { std::reverse(list_.begin(), list_.end()); }
+	uint64_t sum() {
+		uint64_t s = 0;
+		for (const T& v : list_) s += v.key;
+		return s;
+	}
+};
+
+//times one operation and prints a row. 'ops' is the divisor for ns/op and
+//cache misses/op, for scans it is the number of elements visited.
+//bytesPerElem is read after the body runs so the fill can set it
+static CacheMissCounter g_misses;
+//sums and scan results are stored here. every store to a volatile is kept,
+//so the compiler can not drop the work that computes them
+static volatile uint64_t g_sink = 0;
+
+template <class F>
+void measure(const char* variant, size_t elemSize, long long length, const char* op,
+	long long ops, const double& bytesPerElem, F body) {
+	g_misses.start();
+	auto start = chrono::steady_clock::now();
+	body();
+	auto stop = chrono::steady_clock::now();
+	long long misses = g_misses.stop();
+
+	double ns = (double)chrono::duration_cast<chrono::nanoseconds>(stop - start).count();
+	char missCol[32];
+	if (misses < 0) snprintf(missCol, sizeof(missCol), "%s", "n/a");
+	else snprintf(missCol, sizeof(missCol), "%.3f", (double)misses / ops);
+
+	printf("%-20s %5zu %11lld  %-16s %12.2f %12s %10.1f\n",
+		variant, elemSize, length, op, ns / ops, missCol, bytesPerElem);
+	fflush(stdout);
+}
+
+template <class A>
+void runVariant(size_t elemSize, long long length, long long randomOps) {
+	mt19937 rng(12345);
+	int n = (int)length;
+	double bpe = 0;
+	{
+		A a;
+		size_t heapBefore = g_heapBytes;
+
+		measure(A::name(), elemSize, length, "pushBack", length, bpe, [&] {
+			for (int i = 0; i < n; i++) a.pushBack(i);
+			bpe = (double)(g_heapBytes - heapBefore) / length;
+			});
+
+		measure(A::name(), elemSize, length, "iterate", length, bpe, [&] {
+			g_sink = g_sink + a.sum();
+			});
+
+		//a key that is not in the list so every scan walks the whole list
+		int scans = (int)max(1LL, min(100LL, 10000000LL / length));
+		measure(A::name(), elemSize, length, "indexOf (scan)", length * scans, bpe, [&] {
+			for (int s = 0; s < scans; s++) g_sink = g_sink + a.indexOf(0xFFFFFFFFu);
+			});
+
+		measure(A::name(), elemSize, length, "reverse", length, bpe, [&] {
+			a.reverse();
+			});
+
+		vector<int> positions(randomOps);
+		for (auto& pos : positions) pos = (int)(rng() % (uint32_t)n);
+		measure(A::name(), elemSize, length, "addAt (random)", randomOps, bpe, [&] {
+			for (int pos : positions) a.addAt(pos, 7);
+			});
+		measure(A::name(), elemSize, length, "removeAt (random)", randomOps, bpe, [&] {
+			for (int pos : positions) a.removeAt(pos);
+			});
+
+		measure(A::name(), elemSize, length, "popBack", length, bpe, [&] {
+			for (int i = 0; i < n; i++) a.popBack();
+			});
+		measure(A::name(), elemSize, length, "pushFront", length, bpe, [&] {
+			for (int i = 0; i < n; i++) a.pushFront(i);
+			});
+		measure(A::name(), elemSize, length, "popFront", length, bpe, [&] {
+			for (int i = 0; i < n; i++) a.popFront();
+			});
+	}
+}
+
+template <size_t N>
+void runSize(const vector<long long>& lengths, long long randomOps) {
+	typedef Payload<N> T;
+	for (long long length : lengths)
+	{
+		long long ops = min(randomOps, length);
+		runVariant<DoublyAdapter<T>>(N, length, ops);
+		runVariant<CompactAdapter<T>>(N, length, ops);
+		runVariant<IntrusiveAdapter<T>>(N, length, ops);
+		runVariant<StdListAdapter<T>>(N, length, ops);
+		runVariant<StdDequeAdapter<T>>(N, length, ops);
+	}
+}
+
+int main(int argc, char** argv) {
+	long long maxLength = argc > 1 ? atoll(argv[1]) : 1000000;
+	long long randomOps = argc > 2 ? atoll(argv[2]) : 1000;
+	if (maxLength < 1000 || maxLength > 100000000 || randomOps < 1) {
+		cout << "usage: ListBenchmark [maxLength 1000..100000000] [randomOps]" << endl;
+		return 1;
+	}
+
+	vector<long long> lengths;
+	for (long long length = 1000; length <= maxLength; length *= 10) lengths.push_back(length);
+
+	cout << "cache misses: " << (g_misses.available() ? "perf_event_open" : "n/a (perf_event_open unavailable)") << endl;
+	cout << "ns/op and misses/op are per call for push/pop/addAt/removeAt and per element visited for scans" << endl;
+	printf("%-20s %5s %11s  %-16s %12s %12s %10s\n",
+		"variant", "bytes", "length", "op", "ns/op", "misses/op", "heap B/el");
+
+	runSize<4>(lengths, randomOps);
+	runSize<8>(lengths, randomOps);
+	runSize<16>(lengths, randomOps);
+	runSize<32>(lengths, randomOps);
+	runSize<64>(lengths, randomOps);
+	runSize<128>(lengths, randomOps);
+	runSize<256>(lengths, randomOps);
+
+	return 0;
+}
@@ -0,0 +1,243 @@
+//bounded key-value cache built from the DoublyLinkedList and the open adressing
+//hash table. the hash table maps every key straight to its list node, so a hit
+//relinks the node at the front of the list without searching for it
+
+#ifndef D_LRUCACHE_H
+#define D_LRUCACHE_H
+
+#include "../Double Linked List/LinkedList.cpp"
+#include "../HashTable/HashTableOpenAdressingBase.h"
+
+#include <cstddef>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+using namespace std;
+
+namespace dsa {
+	//LRU keeps a single recency list. SLRU (segmented LRU) splits it in a probation
+	//segment for keys seen once and a protected segment for keys hit again, so a
+	//scan over many cold keys can not flush the frequently used ones
+	enum class EvictionPolicy { LRU, SLRU };
+
+	template<class KEY, class VALUE> class LruCache
+	{
+	public:
+		struct Entry {
+			KEY key_;
+			VALUE value_;
+			size_t bytes_;
+			bool protected_;
+		};
+		typedef typename DoublyLinkedList<Entry>::template Node<Entry> EntryNode;
+		typedef function<void(const KEY&, const VALUE&)> EvictionCallback;
+		typedef function<size_t(const KEY&, const VALUE&)> Sizer;
+
+	private:
+		//share of the entry capacity the protected segment may use with SLRU
+		const double PROTECTED_RATIO = 0.8;
+
+		EvictionPolicy policy_;
+		int maxEntries_;
+		size_t maxBytes_; //0 means no limit on bytes
+		size_t bytes_ = 0;
+
+		//most recently used entries are at the front of each list. with LRU only
+		//probation_ is used
+		DoublyLinkedList<Entry> probation_;
+		DoublyLinkedList<Entry> protected_;
+		HashTableOpenAdressingBase<KEY, EntryNode*> index_;
+
+		EvictionCallback onEvict_;
+		Sizer sizer_;
+
+		long long hits_ = 0, misses_ = 0, evictions_ = 0;
+
+	public:
+		LruCache(int maxEntries) :LruCache(maxEntries, 0, EvictionPolicy::LRU) {}
+		LruCache(int maxEntries, size_t maxBytes) :LruCache(maxEntries, maxBytes, EvictionPolicy::LRU) {}
+
+		//designated constructor
+		LruCache(int maxEntries, size_t maxBytes, EvictionPolicy policy) :
+			policy_(policy),
+			maxEntries_(maxEntries),
+			maxBytes_(maxBytes),
+			index_(maxEntries * 2 + 1) {
+			if (maxEntries <= 0) throw invalid_argument("Illegal capacity: " + to_string(maxEntries));
+			sizer_ = [](const KEY&, const VALUE&) { return sizeof(KEY) + sizeof(VALUE); };
+		}
+
+		virtual ~LruCache() {}
+
+		//called with every entry pushed out because a capacity limit was reached
+		void setEvictionCallback(const EvictionCallback& callback) {
+			onEvict_ = callback;
+		}
+
+		//used to charge an entry against the byte limit when put() gets no size
+		void setSizer(const Sizer& sizer) {
+			sizer_ = sizer;
+		}
+
+		//look a key up. on a hit the value is copied to 'value', the entry becomes
+		//the most recently used one and true is returned
+		bool get(const KEY& key, VALUE& value) {
+			EntryNode* node = index_.get(key);
+			if (node == nullptr) {
+				misses_++;
+				return false;
+			}
+			hits_++;
+			node = touch_(node);
+			value = node->data().value_;
+			return true;
+		}
+
+		//true if the key is cached. does not count as a hit or change the order
+		bool contains(const KEY& key) {
+			return index_.get(key) != nullptr;
+		}
+
+		void put(const KEY& key, const VALUE& value) {
+			put(key, value, sizer_(key, value));
+		}
+
+		//insert or update a key charging 'bytes' against the byte limit, then
+		//evict least recently used entries until both limits hold again
+		void put(const KEY& key, const VALUE& value, size_t bytes) {
+			EntryNode* node = index_.get(key);
+
+			//an entry larger than the whole cache is never kept
+			if (maxBytes_ != 0 && bytes > maxBytes_) {
+				if (node != nullptr) erase_(node);
+				return;
+			}
+
+			if (node != nullptr) {
+				bytes_ = bytes_ - node->data().bytes_ + bytes;
+				node->data().value_ = value;
+				node->data().bytes_ = bytes;
+				touch_(node);
+			}
+			else {
+				bytes_ += bytes;
+				index_.put(key, probation_.addFirstNode(Entry{ key, value, bytes, false }));
+			}
+
+			while (size() > maxEntries_ || (maxBytes_ != 0 && bytes_ > maxBytes_)) {
+				evict_();
+			}
+		}
+
+		//drop a key without calling the eviction callback
+		bool remove(const KEY& key) {
+			EntryNode* node = index_.get(key);
+			if (node == nullptr) return false;
+			erase_(node);
+			return true;
+		}
+
+		void clear() {
+			probation_.clear();
+			protected_.clear();
+			index_.clear();
+			bytes_ = 0;
+		}
+
+		//number of cached entries
+		int size() {
+			return probation_.size() + protected_.size();
+		}
+
+		bool isEmpty() {
+			return size() == 0;
+		}
+
+		//bytes currently charged against the byte limit
+		size_t bytes() const {
+			return bytes_;
+		}
+
+		long long hits() const {
+			return hits_;
+		}
+
+		long long misses() const {
+			return misses_;
+		}
+
+		long long evictions() const {
+			return evictions_;
+		}
+
+		double hitRatio() const {
+			long long lookups = hits_ + misses_;
+			return lookups == 0 ? 0.0 : (double)hits_ / lookups;
+		}
+
+		void resetStats() {
+			hits_ = misses_ = evictions_ = 0;
+		}
+
+		string toString() const {
+			stringstream os;
+			os << "LruCache (" << (policy_ == EvictionPolicy::LRU ? "LRU" : "SLRU")
+				<< ", entries " << index_.size() << "/" << maxEntries_
+				<< ", bytes " << bytes_ << "/" << maxBytes_
+				<< ", hits " << hits_ << ", misses " << misses_
+				<< ", evictions " << evictions_ << ")";
+			return os.str();
+		}
+
+		friend ostream& operator << (ostream& strm, const LruCache<KEY, VALUE>& cache) {
+			return strm << cache.toString();
+		}
+
+	private:
+		//mark a node as just used and return the node that now holds the entry.
+		//with SLRU a hit in probation moves the entry to the protected segment,
+		//which needs a new node in the other list
+		EntryNode* touch_(EntryNode* node) {
+			if (policy_ == EvictionPolicy::LRU || node->data().protected_) {
+				listOf_(node).moveToFront(node);
+				return node;
+			}
+
+			Entry entry = probation_.removeNode(node);
+			entry.protected_ = true;
+			node = protected_.addFirstNode(entry);
+			index_.put(entry.key_, node);
+
+			//keep the protected segment inside its share by demoting its
+			//least recently used entry back to probation
+			int protectedMax = max(1, (int)(maxEntries_ * PROTECTED_RATIO));
+			if (protected_.size() > protectedMax) {
+				Entry demoted = protected_.removeNode(protected_.lastNode());
+				demoted.protected_ = false;
+				index_.put(demoted.key_, probation_.addFirstNode(demoted));
+			}
+			return node;
+		}
+
+		//push out the least recently used entry, taken from probation first
+		void evict_() {
+			EntryNode* victim = probation_.isEmpty() ? protected_.lastNode() : probation_.lastNode();
+			Entry entry = erase_(victim);
+			evictions_++;
+			if (onEvict_) onEvict_(entry.key_, entry.value_);
+		}
+
+		Entry erase_(EntryNode* node) {
+			Entry entry = listOf_(node).removeNode(node);
+			index_.remove(entry.key_);
+			bytes_ -= entry.bytes_;
+			return entry;
+		}
+
+		DoublyLinkedList<Entry>& listOf_(EntryNode* node) {
+			return node->data().protected_ ? protected_ : probation_;
+		}
+	};
+} // namespace dsa
+
+#endif //D_LRUCACHE_H
@@ -0,0 +1,404 @@
+//this is a doubly linked list that keeps its nodes in one contiguous array
+//and links them with 32-bit indices instead of pointers
+
+#ifndef D_COMPACTLINKLIST_H
+#define D_COMPACTLINKLIST_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+using namespace std;
+
+namespace dsa {
+	template <typename t>
+	class CompactLinkedList {
+	public:
+		//index value used as the null link
+		static const uint32_t NIL = 0xFFFFFFFFu;
+
+		//a slot of the node array. free slots are chained together through next_
+		struct Node {
+			t data_;
+			uint32_t prev_, next_;
+		};
+
+		//fixed size header written in front of the nodes by serialize()
+		struct Header {
+			uint32_t size_, head_, tail_, free_, slots_;
+		};
+
+	private:
+		vector<Node> nodes_;
+		uint32_t size_ = 0;
+		uint32_t head_;
+		uint32_t tail_;
+		uint32_t free_; //first slot of the free list
+
+		//take a slot from the free list or grow the array by one
+		uint32_t allocate_(const t& elem, uint32_t prev, uint32_t next) {
+			uint32_t idx;
+			if (free_ != NIL) {
+				idx = free_;
+				free_ = nodes_[idx].next_;
+			}
+			else {
+				if (nodes_.size() >= NIL) throw length_error("CompactLinkedList is full");
+				idx = (uint32_t)nodes_.size();
+				nodes_.push_back(Node());
+			}
+			nodes_[idx].data_ = elem;
+			nodes_[idx].prev_ = prev;
+			nodes_[idx].next_ = next;
+			return idx;
+		}
+
+		//give a slot back to the free list
+		void release_(uint32_t idx) {
+			nodes_[idx].prev_ = NIL;
+			nodes_[idx].next_ = free_;
+			free_ = idx;
+		}
+
+	public:
+		CompactLinkedList() :size_(0), head_(NIL), tail_(NIL), free_(NIL) {}
+
+		virtual ~CompactLinkedList() {}
+
+		//iterator class can be used to sequentially access nodes of linked list
+		class Iterator {
+		public:
+			Iterator() noexcept : nodes_(nullptr), curr_(NIL) {}
+			Iterator(const Node* nodes, uint32_t idx) noexcept : nodes_(nodes), curr_(idx) {}
+
+			//prefix ++ overload
+			Iterator& operator++() {
+				if (curr_ != NIL) curr_ = nodes_[curr_].next_;
+				return *this;
+			}
+
+			//postfix ++ overload
+			Iterator operator++(int) {
+				Iterator iterator = *this;
+				++* this;
+				return iterator;
+			}
+
+			bool operator != (const Iterator& iterator) {
+				return curr_ != iterator.curr_;
+			}
+
+			t operator*() {
+				return nodes_[curr_].data_;
+			}
+		private:
+			const Node* nodes_;
+			uint32_t curr_;
+		};
+
+		//empty this linked list, the node array keeps its capacity
+		void clear() {
+			nodes_.clear();
+			head_ = tail_ = free_ = NIL;
+			size_ = 0;
+		}
+
+		//return the size of tis linked list
+		int size() {
+			return (int)size_;
+		}
+
+		//return true if the linked list has no elements
+		bool isEmpty() {
+			return size_ == 0;
+		}
+
+		//reserve room for n nodes so that adding them does not reallocate
+		void reserve(int n) {
+			nodes_.reserve(n);
+		}
+
+		//add an element to the tail of the linked list
+		void add(const t& elem) {
+			addLast(elem);
+		}
+
+		//add a node to the tail of the linked list
+		void addLast(const t& elem) {
+			uint32_t idx = allocate_(elem, tail_, NIL);
+			if (isEmpty()) head_ = idx;
+			else nodes_[tail_].next_ = idx;
+			tail_ = idx;
+			size_++;
+		}
+
+		//add an element to the beginning of this linked list
+		void addFirst(const t& elem) {
+			uint32_t idx = allocate_(elem, NIL, head_);
+			if (isEmpty()) tail_ = idx;
+			else nodes_[head_].prev_ = idx;
+			head_ = idx;
+			size_++;
+		}
+
+		//add an element at a specified index
+		void addAt(int index, const t& data) {
+			if (index < 0 || index > (int)size_) {
+				throw invalid_argument("Illegal Index");
+			}
+			if (index == 0) {
+				addFirst(data);
+				return;
+			}
+
+			if (index == (int)size_) {
+				addLast(data);
+				return;
+			}
+
+			uint32_t temp = head_;
+			for (int i = 0; i < index - 1; i++)
+			{
+				temp = nodes_[temp].next_;
+			}
+			uint32_t next = nodes_[temp].next_;
+			uint32_t idx = allocate_(data, temp, next);
+			nodes_[next].prev_ = idx;
+			nodes_[temp].next_ = idx;
+
+			size_++;
+		}
+
+		//check the value of the first node if it exists
+		t peekFirst() {
+			if (isEmpty()) throw runtime_error("empty list");
+			return nodes_[head_].data_;
+		}
+
+		//check the value of the last node if it exists
+		t peekLast() {
+			if (isEmpty()) throw runtime_error("empty list");
+			return nodes_[tail_].data_;
+		}
+
+		//remove the first value at the head of the linked list
+		t removeFirst() {
+			if (isEmpty()) throw runtime_error("empty list");
+
+			uint32_t idx = head_;
+			t data = nodes_[idx].data_;
+			head_ = nodes_[idx].next_;
+			--size_;
+
+			if (isEmpty()) tail_ = NIL;
+			else nodes_[head_].prev_ = NIL;
+
+			release_(idx);
+			return data;
+		}
+
+		//remove the last value at the tail of the linked list
+		t removeLast() {
+			if (isEmpty()) throw runtime_error("empty list");
+
+			uint32_t idx = tail_;
+			t data = nodes_[idx].data_;
+			tail_ = nodes_[idx].prev_;
+			--size_;
+
+			if (isEmpty()) head_ = NIL;
+			else nodes_[tail_].next_ = NIL;
+
+			release_(idx);
+			return data;
+		}
+
+		//reverse the linked list by swapping the links of every node
+		void reverse() {
+			uint32_t current = head_;
+			while (current != NIL)
+			{
+				Node& node = nodes_[current];
+				uint32_t next = node.next_;
+				node.next_ = node.prev_;
+				node.prev_ = next;
+				current = next;
+			}
+			std::swap(head_, tail_);
+		}
+
+		//rewrite the node array in list order and drop the free slots, after
+		//this the list is walked front to back through consecutive memory
+		void compact() {
+			vector<Node> ordered;
+			ordered.reserve(size_);
+			uint32_t i = 0;
+			for (uint32_t trav = head_; trav != NIL; trav = nodes_[trav].next_, i++)
+			{
+				Node node = nodes_[trav];
+				node.prev_ = i == 0 ? NIL : i - 1;
+				node.next_ = i + 1 == size_ ? NIL : i + 1;
+				ordered.push_back(node);
+			}
+			nodes_.swap(ordered);
+			head_ = size_ ? 0 : NIL;
+			tail_ = size_ ? size_ - 1 : NIL;
+			free_ = NIL;
+		}
+	private:
+		t remove_(uint32_t idx) { //remove an arbitrary node from the linked list
+			Node& node = nodes_[idx];
+			if (node.prev_ == NIL) return removeFirst();
+			if (node.next_ == NIL) return removeLast();
+
+			//make the links of adjacent nodes skip over 'node'
+			nodes_[node.next_].prev_ = node.prev_;
+			nodes_[node.prev_].next_ = node.next_;
+
+			t data = node.data_;
+			release_(idx);
+			--size_;
+
+			return data;
+		}
+
+		//walk to the slot at a position, from whichever end is closer
+		uint32_t nodeAt_(int index) const {
+			int i;
+			uint32_t trav;
+			if (index < (int)size_ / 2) {
+				for (i = 0, trav = head_; i != index; i++) trav = nodes_[trav].next_;
+			}
+			else {
+				for (i = (int)size_ - 1, trav = tail_; i != index; i--) trav = nodes_[trav].prev_;
+			}
+			return trav;
+		}
+	public:
+		//remove a node at a particular index
+		t removeAt(int index) {
+			if (index < 0 || index >= (int)size_) {
+				throw invalid_argument("Invalid index");
+			}
+			return remove_(nodeAt_(index));
+		}
+
+		//remove a particular value in the linked list
+		bool remove(const t& obj) {
+			for (uint32_t trav = head_; trav != NIL; trav = nodes_[trav].next_)
+			{
+				if (obj == nodes_[trav].data_)
+				{
+					remove_(trav);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		//find the index of a particular value in the linked list
+		int indexOf(const t& obj) {
+			int index = 0;
+			for (uint32_t trav = head_; trav != NIL; trav = nodes_[trav].next_, index++)
+			{
+				if (obj == nodes_[trav].data_)
+				{
+					return index;
+				}
+			}
+			return -1;
+		}
+
+		//check if a value is contained within the linked list
+		bool contains(const t& obj) {
+			return indexOf(obj) != -1;
+		}
+
+		//root of linked list wrapped in iterator type
+		Iterator begin() {
+			return Iterator(nodes_.data(), head_);
+		}
+
+		//end of linkedlist wrapped in Iterator type
+		Iterator end() {
+			return Iterator(nodes_.data(), NIL);
+		}
+
+		//bytes used by the node array, including slots on the free list
+		size_t memoryUsage() const {
+			return nodes_.capacity() * sizeof(Node);
+		}
+
+		//number of bytes serialize() writes
+		size_t serializedSize() const {
+			return sizeof(Header) + nodes_.size() * sizeof(Node);
+		}
+
+		//copy the whole list, free slots included, into dst with a single memcpy
+		//of the node array. only valid for trivially copyable element types
+		void serialize(void* dst) const {
+			static_assert(is_trivially_copyable<t>::value, "serialize needs a trivially copyable type");
+			Header header = { size_, head_, tail_, free_, (uint32_t)nodes_.size() };
+			memcpy(dst, &header, sizeof(Header));
+			if (!nodes_.empty()) memcpy((char*)dst + sizeof(Header), nodes_.data(), nodes_.size() * sizeof(Node));
+		}
+
+		//rebuild the list from a buffer written by serialize(). the header and
+		//every link are checked first, so a truncated or damaged buffer throws
+		//and leaves the list as it was
+		void deserialize(const void* src, size_t bytes) {
+			static_assert(is_trivially_copyable<t>::value, "deserialize needs a trivially copyable type");
+			Header header;
+			if (bytes < sizeof(Header)) throw invalid_argument("Buffer too small");
+			memcpy(&header, src, sizeof(Header));
+			if (header.slots_ == NIL || bytes < sizeof(Header) + (size_t)header.slots_ * sizeof(Node)) throw invalid_argument("Buffer too small");
+
+			vector<Node> nodes(header.slots_);
+			if (header.slots_) memcpy(nodes.data(), (const char*)src + sizeof(Header), header.slots_ * sizeof(Node));
+
+			//the list must run from head_ to tail_ through size_ slots with
+			//matching back links, and the free list must hold every other slot
+			vector<bool> seen(header.slots_, false);
+			uint32_t count = 0, prev = NIL;
+			for (uint32_t trav = header.head_; trav != NIL; prev = trav, trav = nodes[trav].next_, count++) {
+				if (trav >= header.slots_ || seen[trav] || nodes[trav].prev_ != prev) throw invalid_argument("Corrupt list links");
+				seen[trav] = true;
+			}
+			if (count != header.size_ || prev != header.tail_) throw invalid_argument("Corrupt list links");
+			for (uint32_t trav = header.free_; trav != NIL; trav = nodes[trav].next_, count++) {
+				if (trav >= header.slots_ || seen[trav]) throw invalid_argument("Corrupt free list");
+				seen[trav] = true;
+			}
+			if (count != header.slots_) throw invalid_argument("Corrupt free list");
+
+			nodes_.swap(nodes);
+			size_ = header.size_;
+			head_ = header.head_;
+			tail_ = header.tail_;
+			free_ = header.free_;
+		}
+
+		string toString() const {
+			stringstream os;
+			os << "[ ";
+			uint32_t trav = head_;
+			while (trav != NIL)
+			{
+				os << nodes_[trav].data_;
+				trav = nodes_[trav].next_;
+				if (trav != NIL) os << ", ";
+			}
+			os << " ]";
+			return os.str();
+		}
+
+		friend ostream& operator<<(ostream& strm, const CompactLinkedList<t>& a) {
+			return strm << a.toString();
+		}
+	};
+}
+#endif
@@ -41,6 +41,10 @@ namespace dsa {
 			Node() :prev_(nullptr), next_(nullptr) {}
 			Node(const t& data, Node<t>* prev, Node<t>* next) :data_(data), prev_(prev), next_(next) {}
 
+			//access to the stored value for code holding on to a node
+			t& data() { return data_; }
+			const t& data() const { return data_; }
+
 			string toString() const {
 				stringstream os;
 				os << "Node (" << data_ << ")";
@@ -65,7 +69,7 @@ namespace dsa {
 		//iterator class can be used to sequentially access nodes of linked list
 		class Iterator {
 		public:
-			Iterator() noexcept : currNode_(head_) {}
+			Iterator() noexcept : currNode_(nullptr) {}
 			Iterator(const Node<t>* pNode) noexcept : currNode_(pNode) {}
 
 			Iterator& operator = (Node<t>* pNode) {
@@ -137,7 +141,7 @@ namespace dsa {
 				tail_->next_ = new Node<t>(elem, tail_, nullptr);
 				tail_ = tail_->next_;
 			}
-			size++;
+			size_++;
 		}
 
 		//add an element to the beginning of this linked list
@@ -150,13 +154,13 @@ namespace dsa {
 				head_->prev_ = new Node<t>(elem, nullptr, head_);
 				head_ = head_->prev_;
 			}
-			size++;
+			size_++;
 		}
 
 		//add an element at a specified index
 		void addAt(int index, const t& data) {
-			if (index < 0) {
-				throw ("Illegal Index")
+			if (index < 0 || index > size_) {
+				throw invalid_argument("Illegal Index");
 			}
 			if (index == 0) {
 				addFirst(data);
@@ -199,13 +203,15 @@ namespace dsa {
 
 			//extract the data at the head and move
 			//the head pointer forwards one node
-			t data = head_->data_;
+			Node<t>* node = head_;
+			t data = node->data_;
 			head_ = head_->next_;
-			--size;
+			--size_;
 
 			if (isEmpty()) tail_ = nullptr; // if the list is empty set the tail to NULL
 			else head_->prev_ = nullptr; // do a memory cleanup of the previous ndoe
 
+			delete node;
 			return data; // return the data that was at the first node we just removed
 		}
 
@@ -215,13 +221,15 @@ namespace dsa {
 
 			//extract the data at the tail and move
 			//the tail pointer backwards one node
-			t data = tail_->data_;
+			Node<t>* node = tail_;
+			t data = node->data_;
 			tail_ = tail_->prev_;
 			--size_;
 
 			if (isEmpty()) head_ = nullptr; // if the list is now empty set the head to null
 			else tail_->next_ = nullptr;//do a memory cleanup if the node that was just removed
 
+			delete node;
 			return data; //return the data that was in the last node we just removed
 		}
 
@@ -276,9 +284,7 @@ namespace dsa {
 			t data = node->data_;
 
 			//memory cleanup
-			//node->data=nullptr
-			node->prev_ = nullptr;
-			node->next_ = nullptr;
+			delete node;
 			node = nullptr;
 
 			--size_;
@@ -348,6 +354,50 @@ namespace dsa {
 			return indexOf(obj) != -1;
 		}
 
+		//the node level methods below let a caller keep a pointer to a node
+		//(for example in a hash table) and relink or remove it in O(1)
+
+		//add an element to the beginning of the list and return its node
+		Node<t>* addFirstNode(const t& elem) {
+			addFirst(elem);
+			return head_;
+		}
+
+		//add an element to the tail of the list and return its node
+		Node<t>* addLastNode(const t& elem) {
+			addLast(elem);
+			return tail_;
+		}
+
+		//first and last nodes of the list, nullptr when the list is empty
+		Node<t>* firstNode() {
+			return head_;
+		}
+
+		Node<t>* lastNode() {
+			return tail_;
+		}
+
+		//unlink a node of this list and relink it at the head
+		void moveToFront(Node<t>* node) {
+			if (node == head_) return;
+
+			//skip over the node, it is not the head so it has a previous node
+			node->prev_->next_ = node->next_;
+			if (node->next_ != nullptr) node->next_->prev_ = node->prev_;
+			else tail_ = node->prev_;
+
+			node->prev_ = nullptr;
+			node->next_ = head_;
+			head_->prev_ = node;
+			head_ = node;
+		}
+
+		//remove a node of this list and return its data
+		t removeNode(Node<t>* node) {
+			return remove_(node);
+		}
+
 		//root of linked list wrapped in iterator type
 		Iterator begin() {
 			return Iterator(head_);
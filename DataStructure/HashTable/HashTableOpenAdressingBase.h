@@ -21,6 +21,8 @@
 #include <sstream>
 #include <memory>
 #include <cmath>
+#include <iostream>
+#include <stdexcept>
 
 using namespace std;
 
@@ -57,20 +59,19 @@ namespace dsa {
 		HashTableOpenAdressingBase(int capacity) : HashTableOpenAdressingBase(capacity, DEFAULT_LOAD_FACTOR) {}
 
 		//designated constructor
-		HashTableOpenAdressingBase(int capacity, double loadFactor) {
+		HashTableOpenAdressingBase(int capacity, double loadFactor) : loadFactor(loadFactor) {
 			if (capacity <= 0) throw invalid_argument("Illegal capacity: " + to_string(capacity));
 
 			if (loadFactor <= 0 || isnan(loadFactor) || isinf(loadFactor)) {
 				throw invalid_argument("Illegal loadFactor: " + to_string(loadFactor));
 			}
 
-			loadFactor = loadFactor;
 			capacity_ = max(DEFAULT_CAPACITY, capacity);
 			adjustCapacity();
 			threshold_ = (int)(capacity_ * loadFactor);
 
 			usedKeys_ = vector<int>(capacity_, 0);
-			keys = vector<KEY>(capacity_);
+			keys_ = vector<KEY>(capacity_);
 			values_ = vector<VALUE>(capacity_);
 
 			usedBuckets_ = 0;
@@ -121,7 +122,7 @@ namespace dsa {
 
 		//returns the capacity if the hashtable (used mostly for testing)
 		int getCapacity() const {
-			return keyCount_;
+			return capacity_;
 		}
 
 		//returns true/false depending om whether the hash-table is empty
@@ -164,7 +165,7 @@ namespace dsa {
 			vector<VALUE> hashtableValues;
 			for (int i = 0; i < capacity_; i++)
 			{
-				if (usedKeys_[i] != 0 && usedKeys_[i])
+				if (usedKeys_[i] != 0 && usedKeys_[i] != TOMBSTONE)
 				{
 					hashtableValues.push_back(values_[i]);
 				}
@@ -183,21 +184,26 @@ namespace dsa {
 		// double the size of the hash tbale
 	protected:
 		void resizeTable() {
-			increaseCapacity();
-			adjustCapacity();
-
-			threshold_ = (int)(capacity_ * loadFactor);
-
-			usedKeys_.resize(capacity_, 0);
-			keys_.resize(capacity_);
-			values_.resize(capacity_);
-
+			//keep the old tables aside, they are reinserted below
 			vector<int> oldUsedKeyTable;
-			copy(usedKeys_.begin(), usedKeys_.end(), back_inserter(oldUsedKeyTable));
+			oldUsedKeyTable.swap(usedKeys_);
 			vector<KEY> oldKeyTable;
-			copy(keys_.begin(), keys_.end(), back_inserter(oldKeyTable));
+			oldKeyTable.swap(keys_);
 			vector<VALUE> oldValueTable;
-			copy(values_.begin(), values_.end(), back_inserter(oldValueTable));
+			oldValueTable.swap(values_);
+
+			//when most used buckets are tombstones (lots of insert/remove churn)
+			//rehashing at the same capacity is enough to clean them up
+			if (keyCount_ * 2 >= threshold_) {
+				increaseCapacity();
+				adjustCapacity();
+			}
+
+			threshold_ = (int)(capacity_ * loadFactor);
+
+			usedKeys_ = vector<int>(capacity_, 0);
+			keys_ = vector<KEY>(capacity_);
+			values_ = vector<VALUE>(capacity_);
 
 			clear();
 
@@ -217,7 +223,7 @@ namespace dsa {
 		//Converts a hash value to an index. Essentially, this strips the
 		//negative sign and places the hash value in the domain [0, capacity]
 		int normalizeIndex(size_t keyHash) const {
-			return (keyHash & 0x7FFFFFFF) * %capacity_;
+			return (int)((keyHash & 0x7FFFFFFF) % capacity_);
 		}
 
 	public:
@@ -248,7 +254,7 @@ namespace dsa {
 					{
 						//the key we're trying to insert already exists in the hash-table
 						//so update its value with the most recent value
-						if (key[i] == key)
+						if (keys_[i] == key)
 						{
 							if (j == -1)
 							{
@@ -319,7 +325,7 @@ namespace dsa {
 							//we can perform an optimization by swapping the entries in cells
 							//i and j so that the next time we search for this key it will be
 							//found faster. this is called lazy deletion/relocation
-							if (j != 1)
+							if (j != -1)
 							{
 								//swap the key-value pairs of positions i and j.
 								keys_[j] = keys_[i];
@@ -341,7 +347,7 @@ namespace dsa {
 		//NOTE: returns null if the value is null AND also returns
 		//null if the key does not exists
 		VALUE get(const KEY& key) {
-			VALUE val;
+			VALUE val{};
 			int offset = normalizeIndex(hash<KEY>{}(key));
 
 			//start at the original hash value and probe until we find a spot where our key
@@ -354,7 +360,7 @@ namespace dsa {
 					//of a deleted cells is found to perform lazy relocation later.
 					if (usedKeys_[i] == TOMBSTONE)
 					{
-						if (j == -1) j = 1;
+						if (j == -1) j = i;
 						//we hit a non-null key, perhaps it's the one we're looking for
 					}
 					else
@@ -437,8 +443,7 @@ namespace dsa {
 				MODIFICATION_COUNT_(modificationCount) {
 				if (keysLeft_ != 0)
 				{
-					while (parent_->usedKeys_[index_] == 0 || parent_->usedKeys[index_] == parent_->TOMBSTONE)index_++;
-					keysLeft--;
+					while (parent_->usedKeys_[index_] == 0 || parent_->usedKeys_[index_] == parent_->TOMBSTONE)index_++;
 				}
 			}
 			Iterator& operator=(int idx) {
@@ -451,8 +456,11 @@ namespace dsa {
 				//the contents of the table have been altered
 				if (MODIFICATION_COUNT_ != parent_->modificationCount_) throw runtime_error("Concurrent modification exception");
 				if (keysLeft_ != 0) {
-					while (parent_->usedKeys_[index_] == 0 || parent_->usedKeys_[index_] == parent_->TOMBSTONE) index++;
 					keysLeft_--;
+					index_++;
+					if (keysLeft_ != 0) {
+						while (parent_->usedKeys_[index_] == 0 || parent_->usedKeys_[index_] == parent_->TOMBSTONE) index_++;
+					}
 				}
 				return *this;
 			}
@@ -483,6 +491,11 @@ namespace dsa {
 			return Iterator(this, 0, keyCount_, modificationCount_);
 		}
 
+		//end of the hash-table, reached once no keys are left to visit
+		Iterator end() {
+			return Iterator(this, 0, 0, modificationCount_);
+		}
+
 		//return a string view of this hash-table
 		string toString() const {
 			stringstream os;
@@ -0,0 +1,259 @@
+//this is an intrusive doubly linked list. the elements embed their own links
+//(a ListHook member) so linking and unlinking never allocates, and an object
+//with several hooks can sit on several lists at the same time
+
+#ifndef D_INTRUSIVELINKLIST_H
+#define D_INTRUSIVELINKLIST_H
+
+#include <cstddef>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+using namespace std;
+
+namespace dsa {
+	//link member to embed in the element type, one per list the element can be on
+	class ListHook {
+	private:
+		ListHook* prev_, * next_;
+		const void* owner_; //the list the hook is on, lists of one type share the hook
+
+		template <class t, size_t hookOffset>
+		friend class IntrusiveLinkedList;
+	public:
+		ListHook() :prev_(nullptr), next_(nullptr), owner_(nullptr) {}
+
+		//a hook belongs to the object it is embedded in, copying the object
+		//gives an unlinked hook
+		ListHook(const ListHook&) :prev_(nullptr), next_(nullptr), owner_(nullptr) {}
+		ListHook& operator = (const ListHook&) { return *this; }
+
+		//true while the hook is on a list
+		bool isLinked() const {
+			return next_ != nullptr;
+		}
+	};
+
+	//'hookOffset' selects which ListHook member of t this list links through,
+	//given as its offsetof, e.g.
+	//IntrusiveLinkedList<Task, offsetof(Task, readyHook_)>
+	//t has to be a standard layout type so the offset is well defined
+	template <class t, size_t hookOffset>
+	class IntrusiveLinkedList {
+		static_assert(std::is_standard_layout<t>::value, "the element type must be standard layout");
+		static_assert(hookOffset + sizeof(ListHook) <= sizeof(t), "the hook offset is outside the element");
+	private:
+		//the list is circular around this sentinel, so linking and unlinking
+		//never has to special case the head or the tail
+		ListHook root_;
+		int size_ = 0;
+
+		//convert between an element and its hook
+		static ListHook* hookOf_(t& elem) {
+			return reinterpret_cast<ListHook*>(reinterpret_cast<char*>(&elem) + hookOffset);
+		}
+
+		static t* elemOf_(ListHook* h) {
+			return reinterpret_cast<t*>(reinterpret_cast<char*>(h) - hookOffset);
+		}
+
+		//link an unlinked hook right after 'pos'
+		void link_(ListHook* pos, ListHook* h) {
+			if (h->isLinked()) throw invalid_argument("Element is already linked");
+			h->owner_ = this;
+			h->prev_ = pos;
+			h->next_ = pos->next_;
+			pos->next_->prev_ = h;
+			pos->next_ = h;
+			size_++;
+		}
+
+		void unlink_(ListHook* h) {
+			h->prev_->next_ = h->next_;
+			h->next_->prev_ = h->prev_;
+			h->prev_ = h->next_ = nullptr;
+			h->owner_ = nullptr;
+			size_--;
+		}
+
+		//the hook of an element that must be on this list
+		ListHook* linkedHookOf_(t& elem) const {
+			ListHook* h = hookOf_(elem);
+			if (h->owner_ != this) throw invalid_argument("Element is not on this list");
+			return h;
+		}
+
+	public:
+		IntrusiveLinkedList() {
+			root_.prev_ = root_.next_ = &root_;
+		}
+
+		//the list does not own its elements, it only unlinks them
+		virtual ~IntrusiveLinkedList() {
+			clear();
+		}
+
+		IntrusiveLinkedList(const IntrusiveLinkedList&) = delete;
+		IntrusiveLinkedList& operator = (const IntrusiveLinkedList&) = delete;
+
+		//iterator class can be used to sequentially access elements of linked list
+		class Iterator {
+		public:
+			Iterator() noexcept : curr_(nullptr) {}
+			Iterator(ListHook* h) noexcept : curr_(h) {}
+
+			//prefix ++ overload
+			Iterator& operator++() {
+				curr_ = curr_->next_;
+				return *this;
+			}
+
+			//postfix ++ overload
+			Iterator operator++(int) {
+				Iterator iterator = *this;
+				++* this;
+				return iterator;
+			}
+
+			bool operator != (const Iterator& iterator) {
+				return curr_ != iterator.curr_;
+			}
+
+			t& operator*() {
+				return *elemOf_(curr_);
+			}
+		private:
+			ListHook* curr_;
+		};
+
+		//unlink every element
+		void clear() {
+			ListHook* trav = root_.next_;
+			while (trav != &root_)
+			{
+				ListHook* next = trav->next_;
+				trav->prev_ = trav->next_ = nullptr;
+				trav->owner_ = nullptr;
+				trav = next;
+			}
+			root_.prev_ = root_.next_ = &root_;
+			size_ = 0;
+		}
+
+		//return the size of this linked list
+		int size() const {
+			return size_;
+		}
+
+		bool isEmpty() const {
+			return size_ == 0;
+		}
+
+		//link an element at the tail of the linked list
+		void add(t& elem) {
+			addLast(elem);
+		}
+
+		void addLast(t& elem) {
+			link_(root_.prev_, hookOf_(elem));
+		}
+
+		//link an element at the beginning of this linked list
+		void addFirst(t& elem) {
+			link_(&root_, hookOf_(elem));
+		}
+
+		//link an element right before 'pos', which must be on this list
+		void addBefore(t& pos, t& elem) {
+			link_(linkedHookOf_(pos)->prev_, hookOf_(elem));
+		}
+
+		//link an element right after 'pos', which must be on this list
+		void addAfter(t& pos, t& elem) {
+			link_(linkedHookOf_(pos), hookOf_(elem));
+		}
+
+		//check the first element if it exists
+		t& peekFirst() {
+			if (isEmpty()) throw runtime_error("empty list");
+			return *elemOf_(root_.next_);
+		}
+
+		//check the last element if it exists
+		t& peekLast() {
+			if (isEmpty()) throw runtime_error("empty list");
+			return *elemOf_(root_.prev_);
+		}
+
+		//unlink the element at the head of the linked list
+		t& removeFirst() {
+			t& elem = peekFirst();
+			unlink_(root_.next_);
+			return elem;
+		}
+
+		//unlink the element at the tail of the linked list
+		t& removeLast() {
+			t& elem = peekLast();
+			unlink_(root_.prev_);
+			return elem;
+		}
+
+		//unlink an element of this list in O(1). returns false if the
+		//element is not on this list, even when another list of the same
+		//type holds it through the same hook
+		bool remove(t& elem) {
+			ListHook* h = hookOf_(elem);
+			if (h->owner_ != this) return false;
+			unlink_(h);
+			return true;
+		}
+
+		//true if the element is on this list
+		bool contains(t& elem) const {
+			return hookOf_(elem)->owner_ == this;
+		}
+
+		//reverse the linked list by swapping the links of every hook, the
+		//sentinel included
+		void reverse() {
+			ListHook* current = &root_;
+			do
+			{
+				ListHook* next = current->next_;
+				current->next_ = current->prev_;
+				current->prev_ = next;
+				current = next;
+			} while (current != &root_);
+		}
+
+		//root of linked list wrapped in iterator type
+		Iterator begin() {
+			return Iterator(root_.next_);
+		}
+
+		//end of linkedlist wrapped in Iterator type
+		Iterator end() {
+			return Iterator(&root_);
+		}
+
+		string toString() {
+			stringstream os;
+			os << "[ ";
+			for (ListHook* trav = root_.next_; trav != &root_; )
+			{
+				os << *elemOf_(trav);
+				trav = trav->next_;
+				if (trav != &root_) os << ", ";
+			}
+			os << " ]";
+			return os.str();
+		}
+
+		friend ostream& operator<<(ostream& strm, IntrusiveLinkedList<t, hookOffset>& a) {
+			return strm << a.toString();
+		}
+	};
+}
+#endif